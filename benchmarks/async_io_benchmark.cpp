@@ -0,0 +1,99 @@
+// measures how long reads served from the shadow store wait while reads of a node without a shadow value go to a slow
+// plc on the same server thread, once with those reads sent by the server thread and once with AsyncIO. run it from
+// the root of the repository against the plc mockup with a latency, e.g. `python3 tests/mockup/plc.py 5007 500`
+#include <open62541/plugin/log_stdout.h>
+#include <open62541/server.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static UA_Logger file_logger = *UA_Log_Stdout;
+
+#include "plc.h"
+#include "reactor.h"
+
+using Clock = std::chrono::steady_clock;
+
+// reads arrive every millisecond, every miss_every-th read is a read of a node without a shadow value
+constexpr std::size_t request_count = 2000;
+constexpr std::size_t miss_every = 500;
+constexpr auto request_interval = std::chrono::milliseconds(1);
+
+// handles the requests one after another like the server thread, the latency of a read is counted from the time the
+// request arrived, so a read that waits behind a shadow miss counts the wait as well. without miss_node every read is
+// served from the shadow store
+static void benchmark(const char* name, UA_Server* server, PLC* plc, const std::vector<const PLCNode*>& read_nodes,
+                      const PLCNode* miss_node) {
+    std::vector<double> latencies;
+    const auto start = Clock::now();
+    for (std::size_t i = 0; i < request_count; i++) {
+        const auto arrival = start + i * request_interval;
+        std::this_thread::sleep_until(arrival);
+        UA_DataValue data_value;
+        UA_DataValue_init(&data_value);
+        if (miss_node != nullptr && i % miss_every == miss_every - 1) {
+            // like a node that was just created and wasn't polled yet
+            plc->shadow.invalidate(miss_node->node.identifier.numeric);
+            read_plc_value(server, nullptr, nullptr, &miss_node->node, plc, false, nullptr, &data_value);
+            UA_DataValue_clear(&data_value);
+            continue;
+        }
+        const auto node = read_nodes[i % read_nodes.size()];
+        read_plc_value(server, nullptr, nullptr, &node->node, plc, false, nullptr, &data_value);
+        UA_DataValue_clear(&data_value);
+        latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - arrival).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double p) {
+        return latencies[static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1))];
+    };
+    std::printf("%-24s read latency %8.3f ms (p50) %8.3f ms (p99) %8.3f ms (max)\n", name, percentile(0.5),
+                percentile(0.99), latencies.back());
+}
+
+int main(int argc, char** argv) {
+    UA_Server* server = UA_Server_new();
+    PLC plc("R04CPU", "127.0.0.1", argc > 1 ? std::atoi(argv[1]) : 5007, 0x00, 0xFF, 0x03FF, 0x00);
+    plc.slmp.connect();
+    if (!plc.slmp.connected) {
+        UA_Server_delete(server);
+        return EXIT_FAILURE;
+    }
+    create_plc_node(&plc, server, "tests/test_clients.json");
+    poll_plc(&plc);
+
+    std::vector<const PLCNode*> read_nodes;
+    for (const auto node : plc.polled_nodes) {
+        if (node->count <= 1 && UA_TYPES[node->codec->ua_type].pointerFree) {
+            read_nodes.push_back(node);
+        }
+    }
+    if (read_nodes.size() < 2) {
+        delete_plc_node(&plc, server);
+        UA_Server_delete(server);
+        return EXIT_FAILURE;
+    }
+
+    // the last node is the one that misses, the other nodes are served from the shadow store
+    const auto miss_node = read_nodes.back();
+    read_nodes.pop_back();
+    benchmark("shadow hits only", server, &plc, read_nodes, nullptr);
+    benchmark("misses on server thread", server, &plc, read_nodes, miss_node);
+    {
+        Reactor reactor(4);
+        plc.io.attach(&reactor);
+        benchmark("AsyncIO", server, &plc, read_nodes, miss_node);
+        plc.io.attach(nullptr);
+        reactor.cancel_all();
+        plc.io.cancel();
+    }
+
+    const bool connected = plc.slmp.connected;
+    delete_plc_node(&plc, server);
+    UA_Server_delete(server);
+    return connected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+// compares sending r3 commands one after another with sending them as one pipelined batch, run it against the robot
+// mockup with a latency and terminated commands, e.g. `python3 tests/mockup/robot.py 10001 5 cr`
+#include <open62541/plugin/log_stdout.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static UA_Logger file_logger = *UA_Log_Stdout;
+
+#include "r3.h"
+
+template <typename Function>
+static void benchmark(const char* name, std::size_t iterations, std::size_t command_count, Function function) {
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; i++) {
+        function();
+    }
+    const auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-32s %8.2f ms per batch of %zu commands\n", name, duration / static_cast<double>(iterations),
+                command_count);
+}
+
+int main(int argc, char** argv) {
+    R3 r3("127.0.0.1", argc > 1 ? std::atoi(argv[1]) : 10001);
+    // commands can only be pipelined if their answers are terminated
+    r3.terminator = '\r';
+    r3.connect();
+    if (!r3.connected) {
+        return EXIT_FAILURE;
+    }
+    constexpr std::size_t iterations = 20;
+
+    // encoder values of all axes and the grease maintenance log of the first axis
+    std::vector<std::string> commands;
+    for (int j = 1; j <= 8; j++) {
+        commands.push_back("1;1;VALM_Enc(" + std::to_string(j) + ")");
+    }
+    for (int i = 1; i <= 8; i++) {
+        commands.push_back("1;1;VALC_PMLogGrs(1," + std::to_string(i) + ")");
+    }
+
+    benchmark("one command after another", iterations, commands.size(), [&] {
+        for (const auto& command : commands) {
+            r3.get_answer(command);
+        }
+    });
+    benchmark("pipelined batch", iterations, commands.size(), [&] { r3.get_many(commands); });
+    return r3.connected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,220 @@
+// compares running every plc with its own thread with running all of them with the reactor, run it against the plc
+// mockup, e.g. `python3 tests/mockup/plc.py`. the number of plcs is the second argument, the number of plcs that
+// accept the connection but never answer is the third argument, e.g. `reactor_benchmark 5007 200 2`
+#include <open62541/plugin/log_stdout.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static UA_Logger file_logger = *UA_Log_Stdout;
+
+#include "reactor.h"
+#include "slmp.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto poll_interval = std::chrono::milliseconds(100);
+constexpr auto run_time = std::chrono::seconds(3);
+
+// how late the poll cycles of the answering plcs started, compared to their planned start, and how many polls of the
+// silent plcs timed out
+struct Lateness {
+    std::mutex mutex;
+    std::vector<double> samples;
+    std::atomic<std::size_t> timeouts{0};
+
+    void add(Clock::time_point planned) {
+        const auto late = std::chrono::duration<double, std::milli>(Clock::now() - planned).count();
+        std::scoped_lock<std::mutex> guard(mutex);
+        samples.push_back(late);
+    }
+};
+
+// accepts connections into its backlog and never answers, like a plc that went silent after the connect
+class SilentPLC {
+   public:
+    SilentPLC() {
+#ifdef WIN32
+        ::WSADATA wsadata;
+        WSAStartup(MAKEWORD(2, 2), &wsadata);
+#endif
+        listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = ::inet_addr("127.0.0.1");
+        address.sin_port = 0;
+        ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        ::listen(listener, SOMAXCONN);
+        socklen_t length = sizeof(address);
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ::ntohs(address.sin_port);
+    }
+
+    SilentPLC(SilentPLC const&) = delete;
+    SilentPLC& operator=(SilentPLC const&) = delete;
+
+    ~SilentPLC() {
+#ifdef WIN32
+        ::closesocket(listener);
+        WSACleanup();
+#else
+        ::close(listener);
+#endif
+    }
+
+    int port = 0;
+
+   private:
+    SocketHandle listener;
+};
+
+struct BenchmarkPLC {
+    std::unique_ptr<SLMP> slmp;
+    bool silent;
+};
+
+static bool poll(SLMP& slmp) {
+    return slmp.read_request(SLMP::Device::D, SLMP::DeviceExtension::None, 100, 8).has_value();
+}
+
+static std::vector<BenchmarkPLC> make_plcs(int port, std::size_t count, const SilentPLC& silent_plc,
+                                           std::size_t silent_count) {
+    std::vector<BenchmarkPLC> plcs;
+    for (std::size_t i = 0; i < count + silent_count; i++) {
+        const bool silent = i >= count;
+        plcs.push_back(
+            {std::make_unique<SLMP>("127.0.0.1", silent ? silent_plc.port : port, 0x00, 0xFF, 0x03FF, 0x00), silent});
+    }
+    return plcs;
+}
+
+static void run_threads(std::vector<BenchmarkPLC>& plcs, Lateness& lateness, std::atomic<bool>& running) {
+    std::vector<std::thread> threads;
+    for (auto& plc : plcs) {
+        threads.emplace_back([&plc, &lateness, &running] {
+            auto next_cycle = Clock::now();
+            while (running) {
+                if (!plc.slmp->connected) {
+                    plc.slmp->connect();
+                }
+                if (!plc.silent) {
+                    lateness.add(next_cycle);
+                }
+                next_cycle = Clock::now() + poll_interval;
+                if (!poll(*plc.slmp) && plc.silent) {
+                    lateness.timeouts++;
+                }
+                std::this_thread::sleep_until(next_cycle);
+            }
+        });
+    }
+    std::this_thread::sleep_for(run_time);
+    running = false;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+static void connect_plc(Reactor& reactor, BenchmarkPLC& plc, Lateness& lateness);
+
+// the poll waits for its response with the reactor instead of blocking a worker, so a silent plc only holds a worker
+// while its request is sent. a plc whose poll times out is connected again after the poll interval, like the server
+// reconnects a lost device
+static void poll_cycle(Reactor& reactor, BenchmarkPLC& plc, Lateness& lateness, Clock::time_point planned) {
+    if (!plc.silent) {
+        lateness.add(planned);
+    }
+    const auto next_cycle = Clock::now() + poll_interval;
+    auto answered = std::make_shared<bool>(false);
+    plc.slmp->start_pipeline(1);
+    drive_pipeline(
+        reactor, *plc.slmp,
+        [&plc, answered](bool timed_out) {
+            return plc.slmp->pipeline_step(
+                [&plc](std::size_t) {
+                    return plc.slmp->push_read_request(SLMP::Device::D, SLMP::DeviceExtension::None, 100, 8);
+                },
+                [answered](std::size_t, const auto& data) { *answered = data.has_value(); }, timed_out);
+        },
+        [&reactor, &plc, &lateness, next_cycle, answered] {
+            if (*answered) {
+                reactor.schedule(next_cycle, [&reactor, &plc, &lateness, next_cycle] {
+                    poll_cycle(reactor, plc, lateness, next_cycle);
+                });
+                return;
+            }
+            if (plc.silent) {
+                lateness.timeouts++;
+            }
+            reactor.schedule(next_cycle, [&reactor, &plc, &lateness] { connect_plc(reactor, plc, lateness); });
+        });
+}
+
+static void connect_plc(Reactor& reactor, BenchmarkPLC& plc, Lateness& lateness) {
+    const auto socket = plc.slmp->connect_async();
+    if (!socket.has_value()) {
+        return;
+    }
+    reactor.when_writable(socket.value(), std::chrono::milliseconds(plc.slmp->connect_timeout_ms),
+                          [&reactor, &plc, &lateness](bool writable) {
+                              plc.slmp->finish_connect(writable);
+                              if (plc.slmp->connected) {
+                                  poll_cycle(reactor, plc, lateness, Clock::now());
+                              }
+                          });
+}
+
+static void run_reactor(Reactor& reactor, std::vector<BenchmarkPLC>& plcs, Lateness& lateness) {
+    for (auto& plc : plcs) {
+        connect_plc(reactor, plc, lateness);
+    }
+    std::this_thread::sleep_for(run_time);
+    reactor.cancel_all();
+}
+
+static std::size_t connected_count(const std::vector<BenchmarkPLC>& plcs) {
+    return static_cast<std::size_t>(
+        std::count_if(plcs.begin(), plcs.end(), [](const auto& plc) { return !plc.silent && plc.slmp->connected; }));
+}
+
+static void report(const char* name, std::size_t thread_count, const std::vector<BenchmarkPLC>& plcs,
+                   std::size_t silent_count, Lateness& lateness) {
+    auto& samples = lateness.samples;
+    std::sort(samples.begin(), samples.end());
+    const auto percentile = [&](double p) {
+        return samples.empty() ? 0.0 : samples[static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1))];
+    };
+    std::printf("%-20s %5zu threads %5zu/%zu connected %7zu polls, late by %6.2f ms (p50) %6.2f ms (p99), %zu silent "
+                "plcs timed out %zu times\n",
+                name, thread_count, connected_count(plcs), plcs.size() - silent_count, samples.size(),
+                percentile(0.5), percentile(0.99), silent_count, lateness.timeouts.load());
+}
+
+int main(int argc, char** argv) {
+    const int port = argc > 1 ? std::atoi(argv[1]) : 5007;
+    const std::size_t count = argc > 2 ? static_cast<std::size_t>(std::atoi(argv[2])) : 100;
+    const std::size_t silent_count = argc > 3 ? static_cast<std::size_t>(std::atoi(argv[3])) : 1;
+    SilentPLC silent_plc;
+
+    {
+        auto plcs = make_plcs(port, count, silent_plc, silent_count);
+        Lateness lateness;
+        std::atomic<bool> running{true};
+        run_threads(plcs, lateness, running);
+        report("thread per plc", plcs.size(), plcs, silent_count, lateness);
+    }
+
+    auto plcs = make_plcs(port, count, silent_plc, silent_count);
+    Lateness lateness;
+    Reactor reactor(std::max(4u, std::thread::hardware_concurrency()));
+    run_reactor(reactor, plcs, lateness);
+    report("reactor", reactor.thread_count(), plcs, silent_count, lateness);
+    return connected_count(plcs) == count && count > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+// compares encoding slmp requests for every send with copying requests that were encoded once
+#include <open62541/plugin/log_stdout.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static UA_Logger file_logger = *UA_Log_Stdout;
+
+#include "slmp.h"
+
+template <typename Function>
+static void benchmark(const char* name, std::size_t iterations, Function function) {
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; i++) {
+        function();
+    }
+    const auto duration = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-40s %8.1f ns per request\n", name, duration / static_cast<double>(iterations));
+}
+
+int main() {
+    // the requests are only encoded, nothing is sent
+    SLMP slmp("127.0.0.1", 5007, 0x00, 0xFF, 0x03FF, 0x00);
+    constexpr std::size_t iterations = 1000000;
+
+    const auto [device, device_extension] = SLMP::Command::convert_device_name("U3E0");
+    const auto encoded_read = slmp.encode([&] { return slmp.push_read_request(device, device_extension, 100, 64); });
+    benchmark("read request, encoded per send", iterations, [&] {
+        slmp.push_read_request(device, device_extension, 100, 64);
+        slmp.discard_request();
+    });
+    benchmark("read request, encoded once", iterations, [&] {
+        slmp.push_encoded_request(encoded_read);
+        slmp.discard_request();
+    });
+
+    std::vector<std::byte> encoded_labels;
+    for (std::size_t i = 0; i < 20; i++) {
+        const SLMP::Command command("GlobalLabel" + std::to_string(i));
+        encoded_labels.insert(encoded_labels.end(), command.encoded_label.begin(), command.encoded_label.end());
+    }
+    const auto encoded_label_read =
+        slmp.encode([&] { return slmp.push_random_label_read_request(20, encoded_labels); });
+    benchmark("random label read of 20 labels, per send", iterations, [&] {
+        slmp.push_random_label_read_request(20, encoded_labels);
+        slmp.discard_request();
+    });
+    benchmark("random label read of 20 labels, once", iterations, [&] {
+        slmp.push_encoded_request(encoded_label_read);
+        slmp.discard_request();
+    });
+}
\ No newline at end of file
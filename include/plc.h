@@ -5,114 +5,957 @@
 #include <open62541/types.h>
 #include <open62541/types_generated.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iterator>
+#include <map>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <sstream>
 #include <string>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include "slmp.h"
 #include "wrapper.h"
 
+struct PLCCodec;
+
 struct PLCNode {
     UA_NodeId node;
     std::vector<PLCNode> children;
     std::optional<SLMP::Command> read_command;
-    std::string datatype;
+    // handlers of the datatype of the node, set for every node with a read command
+    const PLCCodec* codec;
     std::size_t count;
     std::string name;
     bool writeable;
 
-    explicit PLCNode(UA_NodeId node) : node{node}, count{0}, writeable{false} {}
+    explicit PLCNode(UA_NodeId node) : node{node}, codec{nullptr}, count{0}, writeable{false} {}
 
-    PLCNode const* get_node(UA_UInt16 namespace_id, UA_UInt32 identifier) const {
-        for (const auto& child_node : children) {
-            if (child_node.node.namespaceIndex == namespace_id &&
-                child_node.node.identifierType == UA_NODEIDTYPE_NUMERIC &&
-                child_node.node.identifier.numeric == identifier) {
-                return &child_node;
-            }
+    [[nodiscard]] PLCNode* contains(const std::string& child_name) {
+        // children are only ever appended, so only the children added since the last lookup are indexed
+        for (; indexed_children < children.size(); indexed_children++) {
+            child_indices.emplace(children[indexed_children].name, indexed_children);
         }
-        for (const auto& child_node : children) {
-            const auto result = child_node.get_node(namespace_id, identifier);
-            if (result != nullptr) {
-                return result;
-            }
-        }
-        return nullptr;
+        const auto it = child_indices.find(child_name);
+        return (it != child_indices.end()) ? &children[it->second] : nullptr;
     }
 
-    [[nodiscard]] PLCNode* contains(const std::string child_name) {
-        for (auto& i : children) {
-            if (i.name == child_name) {
-                return &i;
-            }
-        }
-        return nullptr;
-    }
+   private:
+    std::unordered_map<std::string, std::size_t> child_indices;
+    std::size_t indexed_children = 0;
+};
+
+// node of the plc specification, compiled once from the json so that creating the nodes of a plc doesn't access the
+// json
+struct PLCNodeTemplate {
+    enum class Type { None, Object, Property, Device, GlobalLabel };
+
+    Type type;
+    std::string name;
+    uint32_t count = 0;
+    bool writeable = false;
+    const PLCCodec* codec = nullptr;
+    // nothing for a device that isn't a valid slmp device
+    std::optional<SLMP::Command> read_command;
+    std::vector<PLCNodeTemplate> children;
+};
+
+// device requests needed to read a set of nodes, neighbouring device nodes are read together in one request. every
+// request is encoded once when the plan is made, so that executing the plan again only copies the encoded requests
+struct PLCReadPlan {
+    // range of consecutive words, every node is decoded from its word offset into the range
+    struct DeviceRead {
+        SLMP::Command command;
+        std::size_t word_count;
+        std::vector<std::pair<const PLCNode*, std::size_t>> nodes;
+        SLMP::EncodedRequest request;
+    };
+
+    // labels read with one random label read request
+    struct LabelRead {
+        std::vector<std::byte> encoded_labels;
+        std::vector<const PLCNode*> nodes;
+        SLMP::EncodedRequest request;
+    };
+
+    // array labels read with one array label read request
+    struct ArrayLabelRead {
+        std::vector<SLMP::ArrayLabel> arrays;
+        std::vector<const PLCNode*> nodes;
+        SLMP::EncodedRequest request;
+    };
+
+    std::vector<DeviceRead> device_reads;
+    std::vector<LabelRead> label_reads;
+    std::vector<ArrayLabelRead> array_label_reads;
+    // array labels larger than one frame are read in chunks on their own
+    std::vector<const PLCNode*> large_array_label_reads;
+};
+
+// device reads of the poll plan that are registered for monitor requests, the registered words and double words of
+// a read are copied back into one range of consecutive words and decoded like the response of the read
+struct PLCMonitorPlan {
+    // position of the words of a device read in the monitor response
+    struct Layout {
+        std::size_t first_double_word;
+        std::size_t double_word_count;
+        // the last word of a read with an odd number of words is registered as a single word
+        std::optional<std::size_t> word;
+    };
+
+    PLCReadPlan reads;
+    std::vector<SLMP::Command> words;
+    std::vector<SLMP::Command> double_words;
+    std::vector<Layout> layouts;
+    // words of the device read that is decoded from the monitor response, kept so that a poll cycle doesn't allocate
+    std::vector<std::byte> words_buffer;
+};
+
+// state of one connection in a poll cycle
+struct PLCReadScratch {
+    // values decoded from the responses of the connection, reset for every response
+    ScratchArena arena;
+    // nodes of failed label requests, which are read on their own after the cycle
+    std::vector<const PLCNode*> retries;
 };
 
 struct PLC : public Client {
     std::string name;
     SLMP slmp;
     PLCNode node;
+    std::vector<const PLCNode*> polled_nodes;
+    // all nodes of the plc by their numeric node id
+    std::unordered_map<UA_UInt32, const PLCNode*> indexed_nodes;
+    PLCReadPlan poll_plan;
+    // max number of unread words between two device nodes that are still read with one request
+    std::size_t coalesce_gap = 8;
+    // registers the device reads of the poll plan with the plc, so that a poll cycle only sends a monitor request
+    bool monitor = false;
+    PLCMonitorPlan monitor_plan;
+    // values of the property nodes read while the nodes were created, the structure of the plc is unchanged as long
+    // as the plc returns the same values
+    std::vector<std::pair<SLMP::Command, std::string>> property_checks;
+    // additional connections to other ports of the plc, the requests of a poll cycle and writes are spread over slmp
+    // and these connections
+    std::vector<std::unique_ptr<SLMP>> connections;
+    // scratch space of every connected slmp for its part of a poll cycle, kept between the cycles so that a poll
+    // cycle doesn't allocate
+    std::vector<PLCReadScratch> read_scratch;
+    // runs the requests of the additional connections in a poll cycle on the workers of the reactor
+    ParallelBatch connection_reads;
+    // connections whose pipeline of an async poll cycle didn't finish yet
+    std::atomic<std::size_t> pending_connections{0};
+    // whether the monitor request of an async poll cycle failed
+    bool monitor_failed = false;
 
     PLC(std::string name, std::string ip, int port, uint8_t network_no, uint8_t station_no, uint16_t module_io,
         uint8_t multidrop_station_no)
         : name{std::move(name)},
           slmp(std::move(ip), port, network_no, station_no, module_io, multidrop_station_no),
-          node{{}} {}
+          node{{}},
+          read_scratch(1) {}
 
     bool connected() {
         return slmp.connected;
     }
+
+    // slmp and all additional connections that are connected, with read scratch space for each of them. the list is
+    // reused by the next call
+    const std::vector<SLMP*>& connected_slmps() {
+        slmps.assign(1, &slmp);
+        for (const auto& connection : connections) {
+            if (connection->connected) {
+                slmps.push_back(connection.get());
+            }
+        }
+        if (read_scratch.size() < slmps.size()) {
+            read_scratch.resize(slmps.size());
+        }
+        return slmps;
+    }
+
+    // writes to the same device or label always use the same connection, so that they stay in order
+    SLMP& write_connection(const SLMP::Command& command) {
+        if (connections.empty()) {
+            return slmp;
+        }
+        const auto hash = command.is_label ? std::hash<std::string>{}(command.label)
+                                           : std::hash<uint32_t>{}(static_cast<uint32_t>(command.device) << 16 |
+                                                                    static_cast<uint32_t>(command.device_extension));
+        const auto index = hash % (connections.size() + 1);
+        if (index == 0 || !connections[index - 1]->connected) {
+            return slmp;
+        }
+        return *connections[index - 1];
+    }
+
+   private:
+    std::vector<SLMP*> slmps;
 };
 
-static UA_StatusCode read_plc_value(UA_Server* server, const UA_NodeId* sessionId, void* sessionContext,
-                                    const UA_NodeId* nodeId, void* nodeContext, UA_Boolean sourceTimeStamp,
-                                    const UA_NumericRange* range, UA_DataValue* dataValue) {
-    const auto plc = static_cast<PLC*>(nodeContext);
-    const PLCNode* node;
-    if (plc && (node = plc->node.get_node(nodeId->namespaceIndex, nodeId->identifier.numeric)) != nullptr &&
-        node->read_command.has_value()) {
-        if (!plc->slmp.connected) {
-            return UA_STATUSCODE_BADDEVICEFAILURE;
+// element type of a plc datatype in arrays, bool arrays are read from bit devices with one byte per element
+template <typename Type>
+using PLCElement = std::conditional_t<std::is_same_v<Type, bool>, uint8_t, Type>;
+
+// element type of the opc ua value of a plc datatype, strings point into the data they were decoded from
+template <typename Type>
+using PLCValue = std::conditional_t<std::is_same_v<Type, std::string>, UA_String, PLCElement<Type>>;
+
+// points value at the elements of node built in the scratch arena of the device
+template <std::size_t UAType, typename Type>
+void borrow_plc_values(const PLCNode* node, Type* data, UA_Variant* value) {
+    if (node->count <= 1) {
+        borrow_scalar(value, data, &UA_TYPES[UAType]);
+    } else {
+        borrow_array(value, data, node->count, &UA_TYPES[UAType]);
+    }
+}
+
+// string of at most size bytes of data that ends at the first `0 byte`, the string points into data. without data
+// the string is empty, but not a null string
+inline UA_String borrow_plc_string(const std::byte* data, std::size_t size) {
+    static const char empty[] = "";
+    const auto text = size > 0 ? reinterpret_cast<const char*>(data) : empty;
+    return UA_String{strnlen(text, size), reinterpret_cast<UA_Byte*>(const_cast<char*>(text))};
+}
+
+// decodes strings of string_size bytes each, the strings are left empty if data is too short
+inline void decode_plc_strings(const std::byte* data, std::size_t size, std::size_t string_size,
+                               tcb::span<UA_String> strings) {
+    const bool complete = size >= strings.size() * string_size;
+    for (std::size_t i = 0; i < strings.size(); i++) {
+        strings[i] = complete ? borrow_plc_string(data + i * string_size, string_size) : borrow_plc_string(nullptr, 0);
+    }
+}
+
+// reads the current value of node from the plc into value with a request of its own
+template <typename Type, std::size_t UAType>
+void read_plc_values(SLMP& slmp, const PLCNode* node, ScratchArena& arena, UA_Variant* value) {
+    const auto& command = node->read_command.value();
+    const auto count = std::max<std::size_t>(node->count, 1);
+    const auto data = arena.allocate<PLCValue<Type>>(count);
+    if constexpr (std::is_same_v<Type, std::string>) {
+        // the strings are read on their own and copied into the arena
+        std::vector<std::string> strings(count);
+        if (node->count <= 1) {
+            strings.front() = slmp.get<std::string>(command);
+        } else {
+            slmp.get<std::string>(command, strings);
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            const auto bytes = arena.allocate<std::byte>(strings[i].size());
+            std::memcpy(bytes, strings[i].data(), strings[i].size());
+            data[i] = borrow_plc_string(bytes, strings[i].size());
         }
-        if (node->datatype == "Bool") {
-            const auto value = plc->slmp.get<bool>(node->read_command.value());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_BOOLEAN]);
-        } else if (node->datatype == "Word") {
-            const auto value = plc->slmp.get<uint16_t>(node->read_command.value());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_UINT16]);
-        } else if (node->datatype == "DWord") {
-            const auto value = plc->slmp.get<uint32_t>(node->read_command.value());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_UINT32]);
-        } else if (node->datatype == "Int") {
-            const auto value = plc->slmp.get<int16_t>(node->read_command.value());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_INT16]);
-        } else if (node->datatype == "DInt") {
-            const auto value = plc->slmp.get<int32_t>(node->read_command.value());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_INT32]);
-        } else if (node->datatype == "Float") {
-            const auto value = plc->slmp.get<float>(node->read_command.value());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_FLOAT]);
-        } else if (node->datatype == "Double") {
-            const auto value = plc->slmp.get<double>(node->read_command.value());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
-        } else if (node->datatype == "String") {
-            auto data = plc->slmp.get<std::string>(node->read_command.value());
-            const auto value = UA_STRING(data.data());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_STRING]);
+    } else if (node->count <= 1) {
+        data[0] = slmp.get<Type>(command);
+    } else {
+        slmp.get<PLCElement<Type>>(command, tcb::span<PLCElement<Type>>{data, count});
+    }
+    borrow_plc_values<UAType>(node, data, value);
+}
+
+// decodes the value of node from the words read from the plc, a single bool is decoded from a word
+template <typename Type, std::size_t UAType>
+void decode_plc_values(const PLCNode* node, const std::byte* words, std::size_t size, ScratchArena& arena,
+                       UA_Variant* value) {
+    const auto& command = node->read_command.value();
+    const auto count = std::max<std::size_t>(node->count, 1);
+    const auto data = arena.allocate<PLCValue<Type>>(count);
+    if constexpr (std::is_same_v<Type, std::string>) {
+        decode_plc_strings(words, size, command.length, {data, count});
+    } else if constexpr (std::is_same_v<Type, bool>) {
+        if (node->count <= 1) {
+            uint16_t word = 0;
+            SLMP::decode<uint16_t>(command, words, size, tcb::span<uint16_t>{&word, 1});
+            data[0] = static_cast<PLCValue<Type>>(word != 0);
         } else {
-            throw std::runtime_error{"Invalid data type"};
+            SLMP::decode<PLCElement<Type>>(command, words, size, tcb::span<PLCElement<Type>>{data, count});
         }
     } else {
-        const double value = 0;
-        UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+        SLMP::decode<PLCElement<Type>>(command, words, size, tcb::span<PLCElement<Type>>{data, count});
+    }
+    borrow_plc_values<UAType>(node, data, value);
+}
+
+template <typename Type>
+Type plc_label_value(std::pair<const std::byte*, std::size_t> label) {
+    Type value{};
+    std::memcpy(&value, label.first, std::min(sizeof(Type), label.second));
+    return value;
+}
+
+// decodes the value of a label node from its data in a random label read response, label is empty if the request
+// failed
+template <typename Type, std::size_t UAType>
+void decode_plc_label_value(const PLCNode* node, std::pair<const std::byte*, std::size_t> label, ScratchArena& arena,
+                            UA_Variant* value) {
+    const auto data = arena.allocate<PLCValue<Type>>(1);
+    if constexpr (std::is_same_v<Type, std::string>) {
+        data[0] = borrow_plc_string(label.first, label.second);
+    } else if constexpr (std::is_same_v<Type, bool>) {
+        data[0] = plc_label_value<uint16_t>(label) != 0;
+    } else {
+        data[0] = plc_label_value<Type>(label);
+    }
+    borrow_plc_values<UAType>(node, data, value);
+}
+
+// decodes the value of an array label node from its data in an array label read response
+template <typename Type, std::size_t UAType>
+void decode_plc_array_label_values(const PLCNode* node, const std::byte* array_data, std::size_t size,
+                                   ScratchArena& arena, UA_Variant* value) {
+    const auto& command = node->read_command.value();
+    const auto data = arena.allocate<PLCValue<Type>>(node->count);
+    if constexpr (std::is_same_v<Type, std::string>) {
+        decode_plc_strings(array_data, size, SLMP::label_string_size(command), {data, node->count});
+    } else {
+        SLMP::decode_array_label<PLCElement<Type>>(command, array_data, size,
+                                                   tcb::span<PLCElement<Type>>{data, node->count});
+    }
+    borrow_plc_values<UAType>(node, data, value);
+}
+
+// size of the data of a label (or array element) in a label response, 0 for elements of bool arrays which are read
+// as bits
+template <typename Type>
+std::size_t plc_label_data_size(const PLCNode* node) {
+    if constexpr (std::is_same_v<Type, bool>) {
+        return node->count <= 1 ? 2 : 0;
+    } else if constexpr (std::is_same_v<Type, std::string>) {
+        return SLMP::label_string_size(node->read_command.value());
+    } else {
+        return sizeof(Type);
+    }
+}
+
+// number of words read from the device for the value of node
+template <typename Type>
+std::size_t plc_word_count(const PLCNode* node) {
+    const auto& command = node->read_command.value();
+    if constexpr (std::is_same_v<Type, bool>) {
+        return node->count <= 1 ? SLMP::word_count<uint16_t>(command, 1)
+                                : SLMP::word_count<uint8_t>(command, node->count);
+    } else {
+        return SLMP::word_count<Type>(command, std::max<std::size_t>(node->count, 1));
+    }
+}
+
+// writes value, which has the opc ua type of the node, to the plc. only global labels can be written as arrays
+template <typename Type>
+bool write_plc_values(SLMP& slmp, const PLCNode* node, const UA_Variant* value) {
+    const auto& command = node->read_command.value();
+    if constexpr (std::is_same_v<Type, std::string>) {
+        const auto ua_strings = static_cast<const UA_String*>(value->data);
+        std::vector<std::string> strings;
+        for (std::size_t i = 0; i < std::max<std::size_t>(value->arrayLength, 1); i++) {
+            strings.emplace_back(reinterpret_cast<const char*>(ua_strings[i].data), ua_strings[i].length);
+        }
+        return node->count > 1 ? slmp.write(command, tcb::span<const std::string>{strings})
+                               : slmp.write(command, strings.front());
+    } else if (node->count > 1) {
+        return slmp.write(command, tcb::span<const PLCElement<Type>>{
+                                       static_cast<const PLCElement<Type>*>(value->data), value->arrayLength});
+    } else {
+        return slmp.write(command, *static_cast<const PLCElement<Type>*>(value->data));
+    }
+}
+
+// typed handlers of a plc datatype, resolved once when a node is created so that reading and writing a node doesn't
+// compare datatype names
+struct PLCCodec {
+    // index of the opc ua type of the node in UA_TYPES
+    std::size_t ua_type;
+    // read and decode build the value in arena, value only borrows it until the arena is reset
+    void (*read)(SLMP& slmp, const PLCNode* node, ScratchArena& arena, UA_Variant* value);
+    void (*decode)(const PLCNode* node, const std::byte* words, std::size_t size, ScratchArena& arena,
+                   UA_Variant* value);
+    void (*decode_label)(const PLCNode* node, std::pair<const std::byte*, std::size_t> label, ScratchArena& arena,
+                         UA_Variant* value);
+    void (*decode_array_label)(const PLCNode* node, const std::byte* data, std::size_t size, ScratchArena& arena,
+                               UA_Variant* value);
+    std::size_t (*label_data_size)(const PLCNode* node);
+    std::size_t (*word_count)(const PLCNode* node);
+    bool (*write)(SLMP& slmp, const PLCNode* node, const UA_Variant* value);
+};
+
+template <typename Type, std::size_t UAType>
+const PLCCodec* typed_plc_codec() {
+    static const PLCCodec codec{UAType,
+                                read_plc_values<Type, UAType>,
+                                decode_plc_values<Type, UAType>,
+                                decode_plc_label_value<Type, UAType>,
+                                decode_plc_array_label_values<Type, UAType>,
+                                plc_label_data_size<Type>,
+                                plc_word_count<Type>,
+                                write_plc_values<Type>};
+    return &codec;
+}
+
+// returns the handlers of datatype, nullptr if datatype isn't supported
+inline const PLCCodec* plc_codec(const std::string& datatype) {
+    if (datatype == "Bool") {
+        return typed_plc_codec<bool, UA_TYPES_BOOLEAN>();
+    } else if (datatype == "Word") {
+        return typed_plc_codec<uint16_t, UA_TYPES_UINT16>();
+    } else if (datatype == "DWord") {
+        return typed_plc_codec<uint32_t, UA_TYPES_UINT32>();
+    } else if (datatype == "Int") {
+        return typed_plc_codec<int16_t, UA_TYPES_INT16>();
+    } else if (datatype == "DInt") {
+        return typed_plc_codec<int32_t, UA_TYPES_INT32>();
+    } else if (datatype == "Float") {
+        return typed_plc_codec<float, UA_TYPES_FLOAT>();
+    } else if (datatype == "Double") {
+        return typed_plc_codec<double, UA_TYPES_DOUBLE>();
+    } else if (datatype == "String") {
+        return typed_plc_codec<std::string, UA_TYPES_STRING>();
+    }
+    return nullptr;
+}
+
+// merges the device nodes into as few ranges as possible, ranges of the same device are merged if they are at most
+// coalesce_gap words apart and the merged range can still be read with one request
+inline PLCReadPlan plan_plc_reads(PLC* plc, const std::vector<const PLCNode*>& nodes) {
+    struct DeviceNode {
+        const PLCNode* node;
+        std::size_t word_count;
+    };
+
+    PLCReadPlan plan;
+    std::vector<const PLCNode*> label_nodes;
+    std::vector<const PLCNode*> array_label_nodes;
+    // bit devices address single bits, so only nodes whose head numbers are a multiple of 16 bits apart can share
+    // the words of a range
+    std::map<std::tuple<SLMP::Device, SLMP::DeviceExtension, uint32_t>, std::vector<DeviceNode>> devices;
+    for (const auto node : nodes) {
+        const auto& command = node->read_command.value();
+        if (command.is_label) {
+            (node->count <= 1 ? label_nodes : array_label_nodes).push_back(node);
+            continue;
+        }
+        const uint32_t alignment = SLMP::is_bit_device(command.device) ? command.head_no % 16 : 0;
+        devices[{command.device, command.device_extension, alignment}].push_back({node, node->codec->word_count(node)});
+    }
+
+    const auto max_words = plc->slmp.max_read_words();
+    for (auto& [_, device_nodes] : devices) {
+        std::sort(device_nodes.begin(), device_nodes.end(), [](const DeviceNode& a, const DeviceNode& b) {
+            return a.node->read_command->head_no < b.node->read_command->head_no;
+        });
+        const uint32_t unit = SLMP::is_bit_device(device_nodes.front().node->read_command->device) ? 16 : 1;
+        PLCReadPlan::DeviceRead* read = nullptr;
+        for (const auto& device_node : device_nodes) {
+            const auto& command = device_node.node->read_command.value();
+            if (read != nullptr) {
+                const std::size_t offset = (command.head_no - read->command.head_no) / unit;
+                const std::size_t word_count = std::max(read->word_count, offset + device_node.word_count);
+                if (offset <= read->word_count + plc->coalesce_gap && word_count <= max_words) {
+                    read->word_count = word_count;
+                    read->nodes.emplace_back(device_node.node, offset);
+                    continue;
+                }
+            }
+            plan.device_reads.push_back({command, device_node.word_count, {{device_node.node, 0}}, {}});
+            read = &plan.device_reads.back();
+        }
+    }
+
+    // labels are packed into as few random label reads and array label reads as fit into a request and its response
+    const auto max_request_size = plc->slmp.max_request_data_size() - 4;   // 2 bytes label count, 2 bytes abbreviations
+    const auto max_response_size = plc->slmp.max_response_data_size() - 2;  // 2 bytes label count
+    std::size_t request_size = 0;
+    std::size_t response_size = 0;
+    for (const auto node : label_nodes) {
+        const auto& command = node->read_command.value();
+        // 1 byte data type, 2 bytes data length
+        const auto node_response_size = 3 + node->codec->label_data_size(node);
+        if (plan.label_reads.empty() || request_size + command.encoded_label.size() > max_request_size ||
+            response_size + node_response_size > max_response_size) {
+            plan.label_reads.emplace_back();
+            request_size = 0;
+            response_size = 0;
+        }
+        auto& label_read = plan.label_reads.back();
+        label_read.encoded_labels.insert(label_read.encoded_labels.end(), command.encoded_label.begin(),
+                                         command.encoded_label.end());
+        label_read.nodes.push_back(node);
+        request_size += command.encoded_label.size();
+        response_size += node_response_size;
+    }
+
+    request_size = 0;
+    response_size = 0;
+    for (const auto node : array_label_nodes) {
+        const auto& command = node->read_command.value();
+        const auto element_size = node->codec->label_data_size(node);
+        if (node->count > plc->slmp.max_array_label_elements(command, element_size)) {
+            plan.large_array_label_reads.push_back(node);
+            continue;
+        }
+        auto array = SLMP::array_label(command, 0, node->count, element_size);
+        // 1 byte unit, 1 byte fixed value, 2 bytes data length
+        const auto node_request_size = array.encoded_label.size() + 4;
+        // 1 byte data type, 1 byte unit, 2 bytes data length
+        const auto node_response_size = 4 + SLMP::array_label_data_size(array);
+        if (plan.array_label_reads.empty() || request_size + node_request_size > max_request_size ||
+            response_size + node_response_size > max_response_size) {
+            plan.array_label_reads.emplace_back();
+            request_size = 0;
+            response_size = 0;
+        }
+        plan.array_label_reads.back().arrays.push_back(std::move(array));
+        plan.array_label_reads.back().nodes.push_back(node);
+        request_size += node_request_size;
+        response_size += node_response_size;
+    }
+
+    auto& slmp = plc->slmp;
+    for (auto& read : plan.device_reads) {
+        read.request = slmp.encode([&] {
+            return slmp.push_read_request(read.command.device, read.command.device_extension, read.command.head_no,
+                                          static_cast<uint16_t>(read.word_count));
+        });
+    }
+    for (auto& read : plan.label_reads) {
+        read.request =
+            slmp.encode([&] { return slmp.push_random_label_read_request(read.nodes.size(), read.encoded_labels); });
+    }
+    for (auto& read : plan.array_label_reads) {
+        read.request = slmp.encode([&] { return slmp.push_array_label_read_request(read.arrays); });
+    }
+    return plan;
+}
+
+// moves the device reads of plan that fit into one monitor registration into a monitor plan
+inline PLCMonitorPlan plan_plc_monitor(PLCReadPlan& plan) {
+    PLCMonitorPlan monitor_plan;
+    std::vector<PLCReadPlan::DeviceRead> remaining_reads;
+    bool extended = false;
+    for (auto& read : plan.device_reads) {
+        const auto double_word_count = read.word_count / 2;
+        const bool odd = read.word_count % 2 != 0;
+        const bool read_extended = extended || read.command.device_extension != SLMP::DeviceExtension::None;
+        const auto points = monitor_plan.words.size() + monitor_plan.double_words.size() + double_word_count + odd;
+        if (points > SLMP::max_random_read_words(read_extended)) {
+            remaining_reads.push_back(std::move(read));
+            continue;
+        }
+        extended = read_extended;
+
+        // bit devices are registered in units of 16 bits
+        const uint32_t unit = SLMP::is_bit_device(read.command.device) ? 16 : 1;
+        const auto& command = read.command;
+        PLCMonitorPlan::Layout layout{monitor_plan.double_words.size(), double_word_count, std::nullopt};
+        for (std::size_t i = 0; i < double_word_count; i++) {
+            monitor_plan.double_words.emplace_back(command.device, command.device_extension,
+                                                   command.head_no + static_cast<uint32_t>(i * 2) * unit, 2);
+        }
+        if (odd) {
+            layout.word = monitor_plan.words.size();
+            monitor_plan.words.emplace_back(command.device, command.device_extension,
+                                            command.head_no + static_cast<uint32_t>(double_word_count * 2) * unit, 1);
+        }
+        monitor_plan.layouts.push_back(layout);
+        monitor_plan.reads.device_reads.push_back(std::move(read));
+    }
+    plan.device_reads = std::move(remaining_reads);
+    return monitor_plan;
+}
+
+// the values are decoded into arena and copied into the shadow store
+inline void update_plc_device_read(PLC* plc, const SLMP& slmp, ScratchArena& arena, const PLCReadPlan::DeviceRead& read,
+                                   std::optional<std::pair<std::byte*, std::size_t>> answer) {
+    arena.reset();
+    for (const auto& [node, offset] : read.nodes) {
+        UA_Variant value;
+        UA_Variant_init(&value);
+        const auto start = offset * sizeof(uint16_t);
+        if (answer.has_value() && answer.value().second > start) {
+            node->codec->decode(node, answer.value().first + start, answer.value().second - start, arena, &value);
+        } else {
+            node->codec->decode(node, nullptr, 0, arena, &value);
+        }
+        plc->shadow.store(node->node.identifier.numeric, &value,
+                          slmp.connected ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDEVICEFAILURE);
+    }
+}
+
+// a single invalid label fails a whole label request, so the labels of a failed request are added to retries and
+// read on their own, so that only the invalid label fails
+inline void update_plc_label_read(PLC* plc, const SLMP& slmp, ScratchArena& arena, const PLCReadPlan::LabelRead& read,
+                                  std::optional<std::pair<std::byte*, std::size_t>> answer,
+                                  std::vector<const PLCNode*>& retries) {
+    arena.reset();
+    const tcb::span<std::pair<const std::byte*, std::size_t>> labels{
+        arena.allocate<std::pair<const std::byte*, std::size_t>>(read.nodes.size()), read.nodes.size()};
+    const bool success =
+        answer.has_value() && SLMP::split_label_data(answer.value().first, answer.value().second, labels);
+    if (!success && read.nodes.size() > 1 && slmp.connected) {
+        retries.insert(retries.end(), read.nodes.begin(), read.nodes.end());
+        return;
+    }
+    for (std::size_t i = 0; i < read.nodes.size(); i++) {
+        UA_Variant value;
+        UA_Variant_init(&value);
+        const auto node = read.nodes[i];
+        node->codec->decode_label(node, success ? labels[i] : std::pair<const std::byte*, std::size_t>{}, arena,
+                                  &value);
+        plc->shadow.store(node->node.identifier.numeric, &value,
+                          slmp.connected ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDEVICEFAILURE);
+    }
+}
+
+inline void update_plc_array_label_read(PLC* plc, const SLMP& slmp, ScratchArena& arena,
+                                        const PLCReadPlan::ArrayLabelRead& read,
+                                        std::optional<std::pair<std::byte*, std::size_t>> answer,
+                                        std::vector<const PLCNode*>& retries) {
+    arena.reset();
+    const tcb::span<std::pair<const std::byte*, std::size_t>> arrays{
+        arena.allocate<std::pair<const std::byte*, std::size_t>>(read.nodes.size()), read.nodes.size()};
+    const bool success =
+        answer.has_value() && SLMP::split_array_label_data(answer.value().first, answer.value().second, arrays);
+    if (!success && read.nodes.size() > 1 && slmp.connected) {
+        retries.insert(retries.end(), read.nodes.begin(), read.nodes.end());
+        return;
+    }
+    for (std::size_t i = 0; i < read.nodes.size(); i++) {
+        UA_Variant value;
+        UA_Variant_init(&value);
+        const auto node = read.nodes[i];
+        node->codec->decode_array_label(node, arrays[i].first, arrays[i].second, arena, &value);
+        plc->shadow.store(node->node.identifier.numeric, &value,
+                          slmp.connected ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDEVICEFAILURE);
+    }
+}
+
+// appends request i of the plan, the device reads are followed by the label reads and the array label reads
+inline std::pair<SLMP::RequestCommand, SLMP::Subcommand> prepare_plc_read(SLMP& slmp, const PLCReadPlan& plan,
+                                                                         std::size_t i) {
+    const auto label_start = plan.device_reads.size();
+    const auto array_label_start = label_start + plan.label_reads.size();
+    if (i < label_start) {
+        return slmp.push_encoded_request(plan.device_reads[i].request);
+    } else if (i < array_label_start) {
+        return slmp.push_encoded_request(plan.label_reads[i - label_start].request);
+    }
+    return slmp.push_encoded_request(plan.array_label_reads[i - array_label_start].request);
+}
+
+// updates the shadow values of the nodes of request i of the plan with its response
+inline void handle_plc_read(PLC* plc, SLMP& slmp, PLCReadScratch& scratch, const PLCReadPlan& plan, std::size_t i,
+                            std::optional<std::pair<std::byte*, std::size_t>> answer) {
+    const auto label_start = plan.device_reads.size();
+    const auto array_label_start = label_start + plan.label_reads.size();
+    if (i < label_start) {
+        update_plc_device_read(plc, slmp, scratch.arena, plan.device_reads[i], answer);
+    } else if (i < array_label_start) {
+        update_plc_label_read(plc, slmp, scratch.arena, plan.label_reads[i - label_start], answer, scratch.retries);
+    } else {
+        update_plc_array_label_read(plc, slmp, scratch.arena, plan.array_label_reads[i - array_label_start], answer,
+                                    scratch.retries);
+    }
+}
+
+// number of requests of the plan that connection first of connection_count sends, every connection_count-th request
+// starting at request first
+inline std::size_t plc_connection_requests(const PLCReadPlan& plan, std::size_t first, std::size_t connection_count) {
+    const auto request_count = plan.device_reads.size() + plan.label_reads.size() + plan.array_label_reads.size();
+    return (request_count + connection_count - 1 - first) / connection_count;
+}
+
+// sends every connection-th request of the plan, starting at request first, through the pipeline of slmp
+inline void pipeline_plc_reads(PLC* plc, SLMP& slmp, PLCReadScratch& scratch, const PLCReadPlan& plan,
+                               std::size_t first, std::size_t connection_count) {
+    slmp.pipeline(
+        plc_connection_requests(plan, first, connection_count),
+        [&](std::size_t i) { return prepare_plc_read(slmp, plan, first + i * connection_count); },
+        [&](std::size_t i, std::optional<std::pair<std::byte*, std::size_t>> answer) {
+            handle_plc_read(plc, slmp, scratch, plan, first + i * connection_count, answer);
+        });
+}
+
+// reads the nodes of failed label requests of the connection_count connections and the arrays of the plan that are
+// larger than one frame on their own, after the pipelined requests of the plan
+inline void read_plc_retries(PLC* plc, const PLCReadPlan& plan, std::size_t connection_count) {
+    const auto transaction = plc->slmp.lock();
+    auto& scratch = plc->read_scratch;
+    // arrays larger than one frame are read in chunks on their own
+    auto& retries = scratch[0].retries;
+    retries.insert(retries.end(), plan.large_array_label_reads.begin(), plan.large_array_label_reads.end());
+    for (std::size_t i = 0; i < connection_count; i++) {
+        for (const auto node : scratch[i].retries) {
+            if (!plc->slmp.connected) {
+                return;
+            }
+            auto& arena = scratch[0].arena;
+            arena.reset();
+            UA_Variant value;
+            UA_Variant_init(&value);
+            node->codec->read(plc->slmp, node, arena, &value);
+            plc->shadow.store(node->node.identifier.numeric, &value,
+                              plc->slmp.connected ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDEVICEFAILURE);
+        }
     }
+}
+
+// runs the requests of the plan as one transaction and updates the shadow values of all nodes of the plan, with 4E
+// frames the requests are pipelined. with additional connections the requests are spread over all connections, which
+// run their requests in parallel
+inline void execute_plc_reads(PLC* plc, const PLCReadPlan& plan) {
+    const auto transaction = plc->slmp.lock();
+    const auto& slmps = plc->connected_slmps();
+    auto& scratch = plc->read_scratch;
+    for (std::size_t i = 0; i < slmps.size(); i++) {
+        scratch[i].retries.clear();
+    }
+    auto connection_read = [&](std::size_t i) {
+        pipeline_plc_reads(plc, *slmps[i], scratch[i], plan, i, slmps.size());
+    };
+    plc->connection_reads.run(plc->reactor, slmps.size(), connection_read);
+    read_plc_retries(plc, plan, slmps.size());
+}
+
+// like execute_plc_reads, but no worker waits for the responses, the pipeline of every connection is continued by the
+// reactor whenever responses arrived. finished is called once the shadow values of all nodes of the plan are updated.
+// the nodes that are read on their own after the pipelines are read while a worker waits. the plan has to stay
+// unchanged until finished is called
+template <typename Finished>
+void execute_plc_reads_async(PLC* plc, const PLCReadPlan& plan, Finished finished) {
+    const auto& slmps = plc->connected_slmps();
+    const auto connection_count = slmps.size();
+    for (std::size_t i = 0; i < connection_count; i++) {
+        plc->read_scratch[i].retries.clear();
+    }
+    plc->pending_connections = connection_count;
+    const auto connection_finished = [plc, &plan, connection_count, finished] {
+        if (--plc->pending_connections == 0) {
+            read_plc_retries(plc, plan, connection_count);
+            finished();
+        }
+    };
+    for (std::size_t i = 0; i < connection_count; i++) {
+        auto& slmp = *slmps[i];
+        slmp.start_pipeline(plc_connection_requests(plan, i, connection_count));
+        drive_pipeline(
+            *plc->reactor, slmp,
+            [plc, &slmp, &plan, i, connection_count](bool timed_out) {
+                return slmp.pipeline_step(
+                    [&](std::size_t j) { return prepare_plc_read(slmp, plan, i + j * connection_count); },
+                    [&](std::size_t j, std::optional<std::pair<std::byte*, std::size_t>> answer) {
+                        handle_plc_read(plc, slmp, plc->read_scratch[i], plan, i + j * connection_count, answer);
+                    },
+                    timed_out);
+            },
+            connection_finished);
+    }
+}
+
+// registers the devices of the monitor plan if the connection has no registration yet, returns false if there is
+// nothing to monitor. if the plc rejects the registration, the reads are moved back into the poll plan
+inline bool register_plc_monitor(PLC* plc) {
+    auto& plan = plc->monitor_plan;
+    if (plan.reads.device_reads.empty()) {
+        return false;
+    }
+    if (plc->slmp.monitor_registered || plc->slmp.monitor_registration_request(plan.words, plan.double_words)) {
+        return true;
+    }
+    if (plc->slmp.connected) {
+        UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND,
+                       "Monitor registration of plc %s failed, falling back to read requests", plc->name.data());
+        auto& device_reads = plc->poll_plan.device_reads;
+        device_reads.insert(device_reads.end(), std::make_move_iterator(plan.reads.device_reads.begin()),
+                            std::make_move_iterator(plan.reads.device_reads.end()));
+        plan = {};
+        return false;
+    }
+    for (const auto& read : plan.reads.device_reads) {
+        update_plc_device_read(plc, plc->slmp, plc->read_scratch[0].arena, read, std::nullopt);
+    }
+    return false;
+}
+
+// decodes the response of a monitor request into the shadow values of the monitor plan, returns false if the
+// response is missing or too short, the registration may have been dropped by the plc then and is registered again
+// with the next poll
+inline bool update_plc_monitor(PLC* plc, std::optional<std::pair<std::byte*, std::size_t>> answer) {
+    auto& plan = plc->monitor_plan;
+    const auto size = plan.words.size() * sizeof(uint16_t) + plan.double_words.size() * sizeof(uint32_t);
+    if (!answer.has_value() || answer.value().second < size) {
+        plc->slmp.monitor_registered = false;
+        return false;
+    }
+
+    const auto double_words = answer.value().first + plan.words.size() * sizeof(uint16_t);
+    auto& words = plan.words_buffer;
+    for (std::size_t i = 0; i < plan.layouts.size(); i++) {
+        const auto& layout = plan.layouts[i];
+        const auto& read = plan.reads.device_reads[i];
+        words.resize(read.word_count * sizeof(uint16_t));
+        std::memcpy(words.data(), double_words + layout.first_double_word * sizeof(uint32_t),
+                    layout.double_word_count * sizeof(uint32_t));
+        if (layout.word.has_value()) {
+            std::memcpy(words.data() + layout.double_word_count * sizeof(uint32_t),
+                        answer.value().first + layout.word.value() * sizeof(uint16_t), sizeof(uint16_t));
+        }
+        update_plc_device_read(plc, plc->slmp, plc->read_scratch[0].arena, read,
+                               std::pair<std::byte*, std::size_t>{words.data(), words.size()});
+    }
+    return true;
+}
+
+// reads the device reads of the monitor plan with one monitor request, the devices are registered first if the
+// connection has no registration yet. if the monitor request fails, the reads are sent as read requests
+inline void monitor_plc(PLC* plc) {
+    const auto transaction = plc->slmp.lock();
+    if (register_plc_monitor(plc) && !update_plc_monitor(plc, plc->slmp.monitor_request())) {
+        execute_plc_reads(plc, plc->monitor_plan.reads);
+    }
+}
+
+// like monitor_plc, but the reactor waits for the response of the monitor request, finished is called once the shadow
+// values of the monitor plan are updated. the registration is sent while a worker waits
+template <typename Finished>
+void monitor_plc_async(PLC* plc, Finished finished) {
+    if (!register_plc_monitor(plc)) {
+        finished();
+        return;
+    }
+    plc->slmp.start_pipeline(1);
+    plc->monitor_failed = true;
+    drive_pipeline(
+        *plc->reactor, plc->slmp,
+        [plc](bool timed_out) {
+            return plc->slmp.pipeline_step(
+                [](std::size_t) { return SLMP::push_monitor_request(); },
+                [plc](std::size_t, std::optional<std::pair<std::byte*, std::size_t>> answer) {
+                    plc->monitor_failed = !update_plc_monitor(plc, answer);
+                },
+                timed_out);
+        },
+        [plc, finished] {
+            if (plc->monitor_failed) {
+                execute_plc_reads_async(plc, plc->monitor_plan.reads, finished);
+                return;
+            }
+            finished();
+        });
+}
+
+// refreshes the shadow values of all polled nodes of the plc
+inline void poll_plc(PLC* plc) {
+    if (plc->monitor) {
+        monitor_plc(plc);
+    }
+    execute_plc_reads(plc, plc->poll_plan);
+}
+
+// like poll_plc, but the reactor waits for the responses of the plc instead of a worker, so that a plc that went
+// silent doesn't occupy a worker. finished is called once the shadow values of all polled nodes are updated, the
+// plc is polled right away without a reactor
+template <typename Finished>
+void poll_plc_async(PLC* plc, Finished finished) {
+    if (plc->reactor == nullptr) {
+        poll_plc(plc);
+        finished();
+        return;
+    }
+    const auto poll = [plc, finished] { execute_plc_reads_async(plc, plc->poll_plan, finished); };
+    if (plc->monitor) {
+        monitor_plc_async(plc, poll);
+        return;
+    }
+    poll();
+}
+
+// reads all nodes of the plc without a shadow value in one batch, the caller holds nodes_mutex shared
+inline void read_missing_plc_values(PLC* plc) {
+    std::vector<const PLCNode*> missing;
+    for (const auto polled_node : plc->polled_nodes) {
+        if (!plc->shadow.contains(polled_node->node.identifier.numeric)) {
+            missing.push_back(polled_node);
+        }
+    }
+    execute_plc_reads(plc, plan_plc_reads(plc, missing));
+}
+
+// serves a read from the shadow store, on a miss all nodes of the plc without a value are read in one batch,
+// so that the remaining nodes of the same read request are served from the shadow store. the batch runs on the device
+// queue, with AsyncIO the read doesn't wait for it and is answered right away with BadWaitingForInitialData
+static std::optional<UA_StatusCode> read_plc_shadow_value(const UA_NodeId* nodeId, void* nodeContext,
+                                                          UA_Boolean sourceTimeStamp, UA_DataValue* dataValue) {
+    const auto plc = static_cast<PLC*>(nodeContext);
+    if (!plc) {
+        return {};
+    }
+    if (plc->shadow.read(nodeId->identifier.numeric, dataValue, sourceTimeStamp)) {
+        return UA_STATUSCODE_GOOD;
+    }
+    std::shared_lock<std::shared_mutex> nodes(plc->nodes_mutex);
+    const PLCNode* node = find_node(plc->indexed_nodes, *nodeId);
+    if (node == nullptr || !node->read_command.has_value()) {
+        return {};
+    }
+    if (!plc->slmp.connected) {
+        return UA_STATUSCODE_BADDEVICEFAILURE;
+    }
+    // the queued read takes the lock itself, it runs right away if the queue was just detached
+    nodes.unlock();
+    if (plc->async_io) {
+        if (!plc->missing_read_queued.exchange(true)) {
+            plc->io.push([plc] {
+                plc->missing_read_queued = false;
+                std::shared_lock<std::shared_mutex> queued_nodes(plc->nodes_mutex);
+                read_missing_plc_values(plc);
+            });
+        }
+        return UA_STATUSCODE_BADWAITINGFORINITIALDATA;
+    }
+    // the read waits for the poll cycle that runs on the queue, so that it isn't sent in between its requests
+    const auto read = plc->io.call(
+        [plc] {
+            std::shared_lock<std::shared_mutex> queued_nodes(plc->nodes_mutex);
+            read_missing_plc_values(plc);
+            return true;
+        },
+        0);
+    if (!read.has_value() || !plc->shadow.read(nodeId->identifier.numeric, dataValue, sourceTimeStamp)) {
+        return UA_STATUSCODE_BADDEVICEFAILURE;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode read_plc_value(UA_Server* server, const UA_NodeId* sessionId, void* sessionContext,
+                                    const UA_NodeId* nodeId, void* nodeContext, UA_Boolean sourceTimeStamp,
+                                    const UA_NumericRange* range, UA_DataValue* dataValue) {
+    const auto result = read_plc_shadow_value(nodeId, nodeContext, sourceTimeStamp, dataValue);
+    if (result.has_value()) {
+        return result.value();
+    }
+    const double value = 0;
+    UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    dataValue->hasValue = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode read_plc_array_value(UA_Server* server, const UA_NodeId* sessionId, void* sessionContext,
+                                          const UA_NodeId* nodeId, void* nodeContext, UA_Boolean sourceTimeStamp,
+                                          const UA_NumericRange* range, UA_DataValue* dataValue) {
+    const auto result = read_plc_shadow_value(nodeId, nodeContext, sourceTimeStamp, dataValue);
+    if (result.has_value()) {
+        return result.value();
+    }
+    const double value = 0;
+    UA_Variant_setArrayCopy(&dataValue->value, &value, 1, &UA_TYPES[UA_TYPES_DOUBLE]);
     dataValue->hasValue = true;
     return UA_STATUSCODE_GOOD;
 }
@@ -121,156 +964,152 @@ static UA_StatusCode write_plc_value(UA_Server* server, const UA_NodeId* session
                                      const UA_NodeId* nodeId, void* nodeContext, const UA_NumericRange* range,
                                      const UA_DataValue* dataValue) {
     const auto plc = static_cast<PLC*>(nodeContext);
+    if (plc == nullptr) {
+        return UA_STATUSCODE_GOOD;
+    }
+    std::shared_lock<std::shared_mutex> nodes(plc->nodes_mutex);
     const PLCNode* node;
-    if (plc && (node = plc->node.get_node(nodeId->namespaceIndex, nodeId->identifier.numeric)) != nullptr &&
+    if ((node = find_node(plc->indexed_nodes, *nodeId)) != nullptr &&
         node->writeable && node->read_command.has_value()) {
-        if (!plc->slmp.connected || dataValue->value.arrayLength != 0) {
+        if (!plc->slmp.connected || (node->count > 1 ? dataValue->value.arrayLength != node->count
+                                                     : dataValue->value.arrayLength != 0)) {
             return UA_STATUSCODE_BADDEVICEFAILURE;
         }
-        bool answer;
-        if (dataValue->value.type->typeKind == UA_TYPES[UA_TYPES_BOOLEAN].typeKind) {
-            answer = plc->slmp.write(node->read_command.value(), *static_cast<uint8_t*>(dataValue->value.data));
-        } else if (dataValue->value.type->typeKind == UA_TYPES[UA_TYPES_DOUBLE].typeKind) {
-            answer = plc->slmp.write(node->read_command.value(), *static_cast<double*>(dataValue->value.data));
-        } else if (dataValue->value.type->typeKind == UA_TYPES[UA_TYPES_FLOAT].typeKind) {
-            answer = plc->slmp.write(node->read_command.value(), *static_cast<float*>(dataValue->value.data));
-        } else if (dataValue->value.type->typeKind == UA_TYPES[UA_TYPES_INT32].typeKind) {
-            answer = plc->slmp.write(node->read_command.value(), *static_cast<int32_t*>(dataValue->value.data));
-        } else if (dataValue->value.type->typeKind == UA_TYPES[UA_TYPES_UINT32].typeKind) {
-            answer = plc->slmp.write(node->read_command.value(), *static_cast<uint32_t*>(dataValue->value.data));
-        } else if (dataValue->value.type->typeKind == UA_TYPES[UA_TYPES_INT16].typeKind) {
-            answer = plc->slmp.write(node->read_command.value(), *static_cast<int16_t*>(dataValue->value.data));
-        } else if (dataValue->value.type->typeKind == UA_TYPES[UA_TYPES_UINT16].typeKind) {
-            answer = plc->slmp.write(node->read_command.value(), *static_cast<uint16_t*>(dataValue->value.data));
-        } else if (dataValue->value.type->typeKind == UA_TYPES[UA_TYPES_STRING].typeKind) {
-            // writing of strings only supported for global labels
-            UA_String ua_string = *static_cast<UA_String*>(dataValue->value.data);
-            std::string data(reinterpret_cast<const char*>(ua_string.data), ua_string.length);
-            answer = plc->slmp.write(node->read_command.value(), data);
-        } else {
-            return UA_STATUSCODE_BADDEVICEFAILURE;
+        if (dataValue->value.type == nullptr ||
+            dataValue->value.type->typeKind != UA_TYPES[node->codec->ua_type].typeKind) {
+            return UA_STATUSCODE_BADTYPEMISMATCH;
         }
-        return answer ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDEVICEFAILURE;
+        const auto timeout_ms = plc->write_connection(node->read_command.value()).request_timeout_ms;
+        nodes.unlock();
+
+        // the write runs on the device queue, which takes the lock itself. the value is copied, as a write that
+        // doesn't finish in time is still carried out after the callback returned
+        const std::shared_ptr<UA_Variant> value(UA_Variant_new(), UA_Variant_delete);
+        if (UA_Variant_copy(&dataValue->value, value.get()) != UA_STATUSCODE_GOOD) {
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        const auto node_id = *nodeId;
+        const auto answer = plc->io.call(
+            [plc, node_id, value] {
+                std::shared_lock<std::shared_mutex> queued_nodes(plc->nodes_mutex);
+                const PLCNode* queued_node = find_node(plc->indexed_nodes, node_id);
+                if (queued_node == nullptr ||
+                    !queued_node->codec->write(plc->write_connection(queued_node->read_command.value()), queued_node,
+                                               value.get())) {
+                    return false;
+                }
+                // reads return the written value until the next poll
+                plc->shadow.store_written(node_id.identifier.numeric, value.get());
+                return true;
+            },
+            timeout_ms);
+        if (!answer.has_value()) {
+            return UA_STATUSCODE_BADTIMEOUT;
+        }
+        return answer.value() ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDEVICEFAILURE;
     }
     return UA_STATUSCODE_GOOD;
 }
 
-static UA_StatusCode read_plc_array_value(UA_Server* server, const UA_NodeId* sessionId, void* sessionContext,
-                                          const UA_NodeId* nodeId, void* nodeContext, UA_Boolean sourceTimeStamp,
-                                          const UA_NumericRange* range, UA_DataValue* dataValue) {
-    const auto plc = static_cast<PLC*>(nodeContext);
-    const PLCNode* node;
-    if (plc && (node = plc->node.get_node(nodeId->namespaceIndex, nodeId->identifier.numeric)) != nullptr &&
-        node->read_command.has_value()) {
-        if (!plc->slmp.connected) {
-            return UA_STATUSCODE_BADDEVICEFAILURE;
+inline PLCNodeTemplate compile_plc_node(const nlohmann::basic_json<>& node) {
+    PLCNodeTemplate compiled;
+    const auto type = node["Type"].get<std::string>();
+    compiled.name = node["Name"].get<std::string>();
+    compiled.count = node.contains("Count") ? node["Count"].get<uint32_t>() : 0;
+    if (type == "Object") {
+        compiled.type = PLCNodeTemplate::Type::Object;
+        for (const auto& child_node : node["Children"]) {
+            compiled.children.push_back(compile_plc_node(child_node));
+        }
+    } else if (type == "Property") {
+        compiled.type = PLCNodeTemplate::Type::Property;
+        const auto [device, device_extension] =
+            SLMP::Command::convert_device_name(node["ReadCommand"]["Device"].get<std::string>());
+        compiled.read_command = std::make_optional<SLMP::Command>(
+            device, device_extension, node["ReadCommand"]["Head no"].get<uint32_t>(),
+            node["ReadCommand"].contains("Length") ? node["ReadCommand"]["Length"].get<uint16_t>() : 1u);
+    } else if (type == "Device" || type == "GlobalLabel") {
+        compiled.type = (type == "Device") ? PLCNodeTemplate::Type::Device : PLCNodeTemplate::Type::GlobalLabel;
+        // arrays are only writeable for global labels
+        compiled.writeable = node.contains("Writeable") && node["Writeable"].get<bool>() &&
+                             (compiled.count <= 1 || type == "GlobalLabel");
+        compiled.codec = plc_codec(node["Datatype"].get<std::string>());
+        if (compiled.codec == nullptr) {
+            UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Datatype '%s' of node '%s' is not supported",
+                           node["Datatype"].get<std::string>().c_str(), compiled.name.c_str());
+            compiled.type = PLCNodeTemplate::Type::None;
+            return compiled;
         }
-        if (node->datatype == "Bool") {
-            std::vector<uint8_t> values(node->count);
-            plc->slmp.get<uint8_t>(node->read_command.value(), values);
-            UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_BOOLEAN]);
-        } else if (node->datatype == "Word") {
-            std::vector<uint16_t> values(node->count);
-            plc->slmp.get<uint16_t>(node->read_command.value(), values);
-            UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_UINT16]);
-        } else if (node->datatype == "DWord") {
-            std::vector<uint32_t> values(node->count);
-            plc->slmp.get<uint32_t>(node->read_command.value(), values);
-            UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_UINT32]);
-        } else if (node->datatype == "Int") {
-            std::vector<int16_t> values(node->count);
-            plc->slmp.get<int16_t>(node->read_command.value(), values);
-            UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_INT16]);
-        } else if (node->datatype == "DInt") {
-            std::vector<int32_t> values(node->count);
-            plc->slmp.get<int32_t>(node->read_command.value(), values);
-            UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_INT32]);
-        } else if (node->datatype == "Float") {
-            std::vector<float> values(node->count);
-            plc->slmp.get<float>(node->read_command.value(), values);
-            UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_FLOAT]);
-        } else if (node->datatype == "Double") {
-            std::vector<double> values(node->count);
-            plc->slmp.get<double>(node->read_command.value(), values);
-            UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_DOUBLE]);
-        } else if (node->datatype == "String") {
-            std::vector<std::string> strings(node->count);
-            plc->slmp.get<std::string>(node->read_command.value(), strings);
-            std::vector<UA_String> values(node->count);
-            for (std::size_t i = 0; i < strings.size(); i++) {
-                values[i] = UA_STRING(strings[i].data());
+        if (type == "Device") {
+            const auto [device, device_extension] =
+                SLMP::Command::convert_device_name(node["ReadCommand"]["Device"].get<std::string>());
+            if (device == SLMP::Device::None) {
+                UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Device '%s' is not a valid slmp device",
+                               node["ReadCommand"]["Device"].get<std::string>().c_str());
+                return compiled;
             }
-            UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_STRING]);
+            compiled.read_command = std::make_optional<SLMP::Command>(
+                device, device_extension, node["ReadCommand"]["Head no"].get<uint32_t>(),
+                node["ReadCommand"].contains("Length") ? node["ReadCommand"]["Length"].get<uint16_t>() : 1u);
         } else {
-            throw std::runtime_error{"Invalid data type"};
+            compiled.read_command = std::make_optional<SLMP::Command>(node["ReadCommand"]["Label"].get<std::string>());
+            if (node["ReadCommand"].contains("Length")) {
+                // only used to plan label reads
+                compiled.read_command->length = node["ReadCommand"]["Length"].get<uint16_t>();
+            }
         }
     } else {
-        const double value = 0;
-        UA_Variant_setArrayCopy(&dataValue->value, &value, 1, &UA_TYPES[UA_TYPES_DOUBLE]);
+        compiled.type = PLCNodeTemplate::Type::None;
     }
-    dataValue->hasValue = true;
-    return UA_STATUSCODE_GOOD;
+    return compiled;
 }
 
-inline void parse_plc_node(PLC* plc, UA_Server* server, PLCNode* parent, const nlohmann::basic_json<>& node,
-                           int id = 0) {
-    const auto type = node["Type"].get<std::string>();
-    std::string name = node["Name"].get<std::string>();
-    const uint32_t count = node.contains("Count") ? node["Count"].get<uint32_t>() : 0;
-    if (type == "Object") {
+inline std::vector<PLCNodeTemplate> compile_plc_specification(const nlohmann::basic_json<>& specification) {
+    std::vector<PLCNodeTemplate> nodes;
+    for (const auto& node : specification["Nodes"]) {
+        nodes.push_back(compile_plc_node(node));
+    }
+    return nodes;
+}
+
+inline void parse_plc_node(PLC* plc, UA_Server* server, PLCNode* parent, const PLCNodeTemplate& node) {
+    auto name = node.name;
+    if (node.type == PLCNodeTemplate::Type::Object) {
         auto existing_object = parent->contains(name);
         if (existing_object == nullptr) {
             parent->children.emplace_back(addObjectNode(server, name.data(), parent->node, false));
             parent->children.back().name = name;
             existing_object = &parent->children.back();
         }
-        for (const auto& child_node : node["Children"]) {
-            parse_plc_node(plc, server, existing_object, child_node, id);
+        for (const auto& child_node : node.children) {
+            parse_plc_node(plc, server, existing_object, child_node);
         }
-    } else if (type == "Property") {
-        const auto [device, device_extension] =
-            SLMP::Command::convert_device_name(node["ReadCommand"]["Device"].get<std::string>());
-        const SLMP::Command command(
-            device, device_extension, node["ReadCommand"]["Head no"],
-            node["ReadCommand"].contains("Length") ? node["ReadCommand"]["Length"].get<uint16_t>() : 1u);
-        std::string value = plc->slmp.get<std::string>(command);
+    } else if (node.type == PLCNodeTemplate::Type::Property) {
+        std::string value = plc->slmp.get<std::string>(node.read_command.value());
+        plc->property_checks.emplace_back(node.read_command.value(), value);
         auto datatype_obj = Datatype<UA_String>(value.data());
         parent->children.emplace_back(
             addVariableNode<UA_String>(server, plc, name.data(), {parent->node}, {datatype_obj}, {}, {}, 0));
-    } else if (type == "Device" || type == "GlobalLabel") {
+    } else if (node.type == PLCNodeTemplate::Type::Device || node.type == PLCNodeTemplate::Type::GlobalLabel) {
         // value or enum value
-        if (node.contains("Writeable") && node["Writeable"].get<bool>() && count <= 1) {
-            // read- and writeable (only for non array types for now)
-            parent->children.emplace_back(addVariableNode<UA_String>(server, plc, name.data(), {parent->node}, {},
-                                                                     read_plc_value, write_plc_value, count));
+        if (node.writeable) {
+            // read- and writeable
+            parent->children.emplace_back(addVariableNode<UA_String>(
+                server, plc, name.data(), {parent->node}, {},
+                (node.count <= 1) ? read_plc_value : read_plc_array_value, write_plc_value, node.count));
             parent->children.back().writeable = true;
         } else {
             // only readable
             parent->children.emplace_back(
                 addVariableNode<UA_String>(server, plc, name.data(), {parent->node}, {},
-                                           (count <= 1) ? read_plc_value : read_plc_array_value, {}, count));
+                                           (node.count <= 1) ? read_plc_value : read_plc_array_value, {}, node.count));
         }
 
-        // save read command
-        if (type == "Device") {
-            const auto [device, device_extension] =
-                SLMP::Command::convert_device_name(node["ReadCommand"]["Device"].get<std::string>());
-            if (device == SLMP::Device::None) {
-                UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Device '%s' is not a valid slmp device",
-                               node["ReadCommand"]["Device"].get<std::string>().c_str());
-                return;
-            }
-            parent->children.back().read_command = std::make_optional<SLMP::Command>(
-                device, device_extension, node["ReadCommand"]["Head no"].get<uint32_t>(),
-                node["ReadCommand"].contains("Length") ? node["ReadCommand"]["Length"].get<uint16_t>() : 1u);
-            parent->children.back().datatype = node["Datatype"];
-            parent->children.back().count = count;
-        } else if (type == "GlobalLabel") {
-            // save read command
-            parent->children.back().read_command =
-                std::make_optional<SLMP::Command>(node["ReadCommand"]["Label"].get<std::string>());
-            parent->children.back().datatype = node["Datatype"];
-            parent->children.back().count = count;
+        // save read command, a device that isn't valid has none
+        if (node.read_command.has_value()) {
+            parent->children.back().read_command = node.read_command;
+            parent->children.back().codec = node.codec;
+            parent->children.back().count = node.count;
         }
     }
 }
@@ -279,6 +1118,12 @@ inline void parse_plc_user_node(PLC* plc, UA_Server* server, PLCNode* base_node,
                                 int id = 0) {
     std::string name = node["Name"].get<std::string>().data();
     std::string parent = node["Parent"].get<std::string>().data();
+    const auto codec = plc_codec(node["Datatype"].get<std::string>());
+    if (codec == nullptr) {
+        UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Datatype '%s' of node '%s' is not supported",
+                       node["Datatype"].get<std::string>().c_str(), name.c_str());
+        return;
+    }
 
     // parent names are split with '/'
     // also non-existent parents are created as object nodes
@@ -301,10 +1146,11 @@ inline void parse_plc_user_node(PLC* plc, UA_Server* server, PLCNode* base_node,
     const auto type = node["Type"].get<std::string>();
     const uint32_t count = node.contains("Count") ? node["Count"].get<uint32_t>() : 0;
 
-    if (node.contains("Writeable") && node["Writeable"].get<bool>() && count <= 1) {
-        // read- and writeable (only for non array types for now)
-        parent_node->children.emplace_back(addVariableNode<UA_String>(server, plc, name.data(), {parent_node->node}, {},
-                                                                      read_plc_value, write_plc_value, count));
+    if (node.contains("Writeable") && node["Writeable"].get<bool>() && (count <= 1 || type == "GlobalLabel")) {
+        // read- and writeable (arrays only for global labels)
+        parent_node->children.emplace_back(
+            addVariableNode<UA_String>(server, plc, name.data(), {parent_node->node}, {},
+                                       (count <= 1) ? read_plc_value : read_plc_array_value, write_plc_value, count));
         parent_node->children.back().writeable = true;
     } else {
         // only readable
@@ -326,24 +1172,28 @@ inline void parse_plc_user_node(PLC* plc, UA_Server* server, PLCNode* base_node,
         parent_node->children.back().read_command = std::make_optional<SLMP::Command>(
             device, device_extension, node["ReadCommand"]["Head no"].get<uint32_t>(),
             node["ReadCommand"].contains("Length") ? node["ReadCommand"]["Length"].get<uint16_t>() : 1u);
-        parent_node->children.back().datatype = node["Datatype"];
+        parent_node->children.back().codec = codec;
         parent_node->children.back().count = count;
     } else if (type == "GlobalLabel") {
         // save read command
         parent_node->children.back().read_command =
             std::make_optional<SLMP::Command>(node["ReadCommand"]["Label"].get<std::string>());
-        parent_node->children.back().datatype = node["Datatype"];
+        if (node["ReadCommand"].contains("Length")) {
+            // only used to plan label reads
+            parent_node->children.back().read_command->length = node["ReadCommand"]["Length"].get<uint16_t>();
+        }
+        parent_node->children.back().codec = codec;
         parent_node->children.back().count = count;
     }
 }
 
 inline void create_plc_node(PLC* plc, UA_Server* server, const char* client_file_name) {
-    std::ifstream specs("specifications/plc-specification.json");
-    nlohmann::json data = nlohmann::json::parse(specs, nullptr, true, true);
+    const auto specification = load_specification("specifications/plc-specification.json", compile_plc_specification);
 
     plc->node.node = addObjectNode(server, plc->name.data(), {}, false);
 
-    for (const auto& node : data["Nodes"]) {
+    plc->property_checks.clear();
+    for (const auto& node : *specification) {
         parse_plc_node(plc, server, &plc->node, node);
     }
 
@@ -357,5 +1207,66 @@ inline void create_plc_node(PLC* plc, UA_Server* server, const char* client_file
             }
         }
     }
+
+    {
+        std::unique_lock<std::shared_mutex> nodes(plc->nodes_mutex);
+        plc->polled_nodes.clear();
+        collect_polled_nodes(plc->node, plc->polled_nodes);
+        plc->indexed_nodes.clear();
+        index_nodes(plc->node, plc->indexed_nodes);
+    }
+    plc->poll_plan = plan_plc_reads(plc, plc->polled_nodes);
+    if (plc->monitor) {
+        // the devices are registered again with the next poll, also after a reconnect
+        plc->monitor_plan = plan_plc_monitor(plc->poll_plan);
+        plc->slmp.monitor_registered = false;
+    }
     UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Created plc node");
+}
+
+// reads the property nodes again and returns whether any of them has a different value now
+inline bool plc_structure_changed(PLC* plc) {
+    for (const auto& [command, value] : plc->property_checks) {
+        const auto current = plc->slmp.get<std::string>(command);
+        if (!plc->slmp.connected) {
+            // the checks are repeated after the next reconnect
+            return false;
+        }
+        if (current != value) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void delete_plc_node(PLC* plc, UA_Server* server) {
+    if (UA_NodeId_isNull(&plc->node.node)) {
+        return;
+    }
+    {
+        // waits for the callbacks that still use the nodes, later callbacks don't find them anymore. the server nodes
+        // are deleted without holding the lock, a callback may hold the lock of the server while it waits for it
+        std::unique_lock<std::shared_mutex> nodes(plc->nodes_mutex);
+        plc->polled_nodes.clear();
+        plc->indexed_nodes.clear();
+    }
+    delete_node(server, plc->node.node, true);
+    plc->poll_plan = {};
+    plc->monitor_plan = {};
+    plc->node = PLCNode{UA_NODEID_NULL};
+    plc->shadow.clear();
+}
+
+// creates the nodes of the plc on its first connect. after a reconnect the nodes are kept, so that opc ua clients
+// keep their subscriptions, unless the properties of the plc changed
+inline void update_plc_node(PLC* plc, UA_Server* server, const char* client_file_name) {
+    if (!UA_NodeId_isNull(&plc->node.node)) {
+        if (!plc_structure_changed(plc)) {
+            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Kept plc node %s", plc->name.c_str());
+            return;
+        }
+        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Properties of plc %s changed", plc->name.c_str());
+        delete_plc_node(plc, server);
+    }
+    create_plc_node(plc, server, client_file_name);
 }
\ No newline at end of file
@@ -3,16 +3,27 @@
 #include <fmt/format.h>
 #include <open62541/plugin/log_stdout.h>
 #include <re2/re2.h>
+#include <re2/set.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <charconv>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <future>
 #include <iostream>
 #include <loguru/loguru.hpp>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <tcb/span.hpp>
+#include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -25,6 +36,142 @@
 
 class R3 {
    public:
+    // match of a read command, compiled once. the first capture group of a partial match is the value, the common
+    // shapes `^(?:[^;]*;){n}([^;]*)` (the field after the n-th semicolon) and `^NAME=(.*)` (the text after a prefix)
+    // are extracted without a regular expression
+    class Matcher {
+       public:
+        Matcher() = default;
+
+        // not explicit, so that a match that is only used once can be passed as a string
+        Matcher(std::string pattern) : pattern_{std::move(pattern)} {
+            static const RE2 field_pattern{R"(\^\(\?:\[\^;\]\*;\)\{(\d+)\}\(\[\^;\]\*\)(?:;\?)?)"};
+            static const RE2 prefix_pattern{R"(\^([A-Za-z0-9_]*=)\(\.\*\))"};
+            if (pattern_.empty()) {
+                // an empty match only checks whether there is an answer at all
+                kind = Kind::Prefix;
+                return;
+            }
+            if (pattern_ == "^([^;]*)" || pattern_ == "^([^;]*);?" || pattern_ == "([^;]*)" ||
+                pattern_ == "([^;]*);?") {
+                // an unanchored match of the first field always matches at the beginning of the answer
+                kind = Kind::Field;
+                field = 0;
+            } else if (pattern_ == "^[^;]*;([^;]*)" || pattern_ == "^[^;]*;([^;]*);?") {
+                kind = Kind::Field;
+                field = 1;
+            } else if (RE2::FullMatch(pattern_, field_pattern, &field)) {
+                kind = Kind::Field;
+            } else if (pattern_ == "(.*)" || pattern_ == "^(.*)") {
+                kind = Kind::Prefix;
+            } else if (RE2::FullMatch(pattern_, prefix_pattern, &prefix)) {
+                kind = Kind::Prefix;
+            } else {
+                kind = Kind::Regex;
+                regex = std::make_shared<const RE2>(pattern_);
+            }
+        }
+
+        // returns the first capture group of a partial match of answer
+        std::optional<std::string_view> capture(std::string_view answer) const {
+            switch (kind) {
+                case Kind::Field: {
+                    std::size_t start = 0;
+                    for (std::size_t i = 0; i < field; i++) {
+                        start = answer.find(';', start);
+                        if (start == std::string_view::npos) {
+                            return {};
+                        }
+                        start++;
+                    }
+                    return answer.substr(start, answer.find(';', start) - start);
+                }
+                case Kind::Prefix: {
+                    if (answer.compare(0, prefix.size(), prefix) != 0) {
+                        return {};
+                    }
+                    // `.` doesn't match a newline
+                    return answer.substr(prefix.size(), answer.find('\n', prefix.size()) - prefix.size());
+                }
+                case Kind::Regex: {
+                    re2::StringPiece value;
+                    if (!RE2::PartialMatch(re2::StringPiece{answer.data(), answer.size()}, *regex, &value)) {
+                        return {};
+                    }
+                    return std::string_view{value.data(), value.size()};
+                }
+            }
+            return {};
+        }
+
+        // returns whether answer partially matches, without capturing a value
+        bool matches(std::string_view answer) const {
+            switch (kind) {
+                case Kind::Field:
+                    return capture(answer).has_value();
+                case Kind::Prefix:
+                    return answer.compare(0, prefix.size(), prefix) == 0;
+                case Kind::Regex:
+                    return RE2::PartialMatch(re2::StringPiece{answer.data(), answer.size()}, *regex);
+            }
+            return false;
+        }
+
+        bool empty() const {
+            return pattern_.empty();
+        }
+
+        // index of the semicolon separated field that is captured, if the match captures a whole field
+        std::optional<std::size_t> captured_field() const {
+            if (kind != Kind::Field) {
+                return {};
+            }
+            return field;
+        }
+
+        const std::string& pattern() const {
+            return pattern_;
+        }
+
+       private:
+        enum class Kind { Field, Prefix, Regex };
+
+        std::string pattern_;
+        Kind kind = Kind::Regex;
+        std::size_t field = 0;
+        std::string prefix;
+        std::shared_ptr<const RE2> regex;
+    };
+
+    // the patterns of the enum cases of a read command compiled into one set, so that all cases are matched at once
+    class CaseSet {
+       public:
+        explicit CaseSet(const std::vector<std::tuple<std::string, std::string, int64_t>>& cases)
+            : set{std::make_shared<RE2::Set>(RE2::Options{}, RE2::UNANCHORED)}, indices(cases.size(), -1) {
+            for (std::size_t i = 0; i < cases.size(); i++) {
+                // cases with an invalid pattern never match
+                indices[i] = set->Add(std::get<0>(cases[i]), nullptr);
+            }
+            set->Compile();
+        }
+
+        // returns for every case whether its pattern matches value
+        std::vector<bool> match(std::string_view value) const {
+            std::vector<int> matching;
+            set->Match(re2::StringPiece{value.data(), value.size()}, &matching);
+            std::vector<bool> result(indices.size(), false);
+            for (std::size_t i = 0; i < indices.size(); i++) {
+                result[i] =
+                    indices[i] >= 0 && std::find(matching.begin(), matching.end(), indices[i]) != matching.end();
+            }
+            return result;
+        }
+
+       private:
+        std::shared_ptr<RE2::Set> set;
+        std::vector<int> indices;
+    };
+
     struct Command {
         std::string command;
         std::string match;
@@ -33,6 +180,16 @@ class R3 {
         int position;
         int id;
         std::vector<std::tuple<std::string, std::string, int64_t>> cases;
+        // max age of a cached answer that is still used instead of sending the command again
+        std::chrono::milliseconds max_age;
+        // match and cases compiled when the node is parsed, the match with the arguments of the node formatted in
+        Matcher matcher;
+        std::optional<CaseSet> case_set;
+        // command rendered when the node is parsed with the arguments of the node formatted in. a read command has one
+        // entry per array element, a write command is split into the text before, between and after its values
+        std::vector<std::string> rendered;
+        // format of every value of a write command
+        std::vector<std::string> value_formats;
 
         Command(std::string command, std::string match, int mecha_no, int task_slot_no, int id)
             : command(std::move(command)),
@@ -40,7 +197,8 @@ class R3 {
               mecha_no(mecha_no),
               task_slot_no(task_slot_no),
               position{0},
-              id{id} {}
+              id{id},
+              max_age{0} {}
 
         Command(std::string command, std::string match, int mecha_no, int task_slot_no)
             : Command(std::move(command), std::move(match), 1, 1, 0) {}
@@ -51,156 +209,624 @@ class R3 {
     };
 
     explicit R3(std::string addr, int port = 10001) noexcept
-        : ip_addr{std::move(addr)}, socket(ip_addr.data(), port), buffer(new char[size]) {
-        memset(buffer, 0, size * sizeof(char));
-    }
+        : ip_addr{std::move(addr)}, socket(ip_addr.data(), port), buffer(initial_buffer_size) {}
 
     void connect() {
-        const auto result = socket.connect();
-        if (!result.has_value()) {
-#ifdef WIN32
-            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Couldn't connect to robot at address '%s:%d' %d",
-                        socket.addr, socket.port, WSAGetLastError());
-#else
-            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Couldn't connect to robot at address '%s:%d'",
-                        socket.addr, socket.port);
-#endif
-            this->disconnect();
+        if (!socket.connect(connect_timeout_ms, request_timeout_ms).has_value()) {
+            connect_failed();
             return;
         }
-        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Connected with robot at address '%s:%d'", socket.addr,
-                    socket.port);
-        connected = true;
+        connection_established();
+    }
+
+    // starts connecting without blocking, the returned socket becomes writable once the connect completed, which is
+    // then checked with finish_connect
+    std::optional<SocketHandle> connect_async() {
+        connected = false;
+        const auto handle = socket.connect_async();
+        if (!handle.has_value()) {
+            connect_failed();
+        }
+        return handle;
+    }
+
+    // completes a connect started with connect_async, writable is false if the socket didn't become writable in time
+    void finish_connect(bool writable) {
+        if (!writable || !socket.finish_connect(request_timeout_ms)) {
+            connect_failed();
+            return;
+        }
+        connection_established();
     }
 
     void disconnect() {
         UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Disconnected");
         connected = false;
+        // the rest of a partially received answer never arrives on the next connection
+        received_start = 0;
+        received_end = 0;
     }
 
     template <typename Type>
-    Type get_hex(const std::string& read_command, const std::string& match);
+    Type get_hex(const std::string& read_command, const Matcher& match);
 
     std::string get(const std::string& read_command);
 
     template <typename Type>
-    Type get(const std::string& read_command, const std::string& match);
+    Type get(const std::string& read_command, const Matcher& match);
+
+    template <typename Type>
+    Type get(const std::string& read_command, const Matcher& match, int position);
+
+    // the parse functions decode an answer returned by get_answer or pipeline, so that one answer can be used for
+    // multiple nodes. answers are null terminated after their last character
+    template <typename Type>
+    static Type parse_hex(std::optional<std::string_view> answer, const Matcher& match);
+
+    template <typename Type>
+    static Type parse(std::optional<std::string_view> answer, const Matcher& match);
+
+    static bool parse(std::optional<std::string_view> answer, const Matcher& match, int position);
+
+    static void parse_position(std::optional<std::string_view> answer, const Matcher& match, double* array,
+                               std::size_t array_size);
+
+    // returns the first capture group of match in answer, or nothing if the robot returned no answer
+    static std::optional<std::string_view> capture(std::optional<std::string_view> answer, const Matcher& match);
+
+    // the convert functions decode a value that was already captured from an answer, so that an answer is only
+    // searched once for values that are shared by multiple nodes
+    template <typename Type>
+    static Type convert_hex(std::optional<std::string_view> value);
 
     template <typename Type>
-    Type get(const std::string& read_command, const std::string& match, int position);
+    static Type convert(std::optional<std::string_view> value);
 
-    ~R3() {
-        delete[] buffer;
+    static void convert_position(std::optional<std::string_view> value, double* array, std::size_t array_size);
+
+    // splits an answer into its semicolon separated fields, the fields captured by a field match
+    static std::vector<std::string_view> split_fields(std::string_view answer) {
+        std::vector<std::string_view> fields;
+        std::size_t start = 0;
+        while (true) {
+            const auto end = answer.find(';', start);
+            fields.push_back(answer.substr(start, end - start));
+            if (end == std::string_view::npos) {
+                return fields;
+            }
+            start = end + 1;
+        }
     }
 
     volatile bool connected = false;
+    // max time in ms a connect may take
+    int connect_timeout_ms = 5000;
+    // max time in ms the robot may take for an answer before the connection is dropped, 0 waits forever. a device
+    // that goes silent holds a worker of the reactor for this long, so it is kept well below the connect timeout
+    int request_timeout_ms = 2000;
 
+    // sends a command that changes the state of the robot, all cached answers are outdated afterwards
     bool execute(std::string command) {
-        return get_answer(command).has_value();
+        const auto answer = get_answer(command);
+        clear_cache();
+        return answer.has_value();
     }
 
-    void get_position(const std::string& read_command, const std::string& match, double* array, std::size_t array_size);
+    void get_position(const std::string& read_command, const Matcher& match, double* array, std::size_t array_size);
 
-   private:
-    std::string ip_addr;
-    Socket socket;
-    char* buffer;
-    static constexpr ::std::size_t size = 400;
+    // returns the answer without the leading 'QoK', or nothing if the robot returned an error
+    std::optional<std::string> get_answer(const std::string& command) {
+        std::optional<std::string> answer;
+        pipeline({&command, 1}, [&](std::size_t, std::optional<std::string_view> data) {
+            if (data.has_value()) {
+                answer.emplace(data.value());
+            }
+        });
+        return answer;
+    }
 
-    std::optional<const char*> get_answer(const std::string& command) {
+    // like get_answer for a batch of commands, the answers are returned in the order of the commands
+    std::vector<std::optional<std::string>> get_many(tcb::span<const std::string> commands) {
+        std::vector<std::optional<std::string>> answers(commands.size());
+        pipeline(commands, [&](std::size_t i, std::optional<std::string_view> data) {
+            if (data.has_value()) {
+                answers[i].emplace(data.value());
+            }
+        });
+        return answers;
+    }
+
+    // sends the commands with up to max_pending_commands of them ahead of their answers, so that a batch costs about
+    // one round trip instead of one per command. the robot answers in the order of the commands, handle(i, answer) is
+    // called with the answer to command i, which is empty if the robot returned an error or the connection was lost.
+    // answer points into the receive buffer and is only valid during the call of handle
+    template <typename Handle>
+    void pipeline(tcb::span<const std::string> commands, Handle handle) {
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        begin_pipeline(commands);
+        bool timed_out = false;
+        while (!continue_pipeline(handle, timed_out)) {
+            timed_out = !socket.readable_until(pipeline_deadline);
+        }
+    }
+
+    // starts a pipeline of commands like pipeline, which is continued with pipeline_step instead of waiting for the
+    // answers. commands have to outlive the pipeline
+    void start_pipeline(tcb::span<const std::string> commands) {
         const std::lock_guard<std::mutex> lock(this->mutex);
-        const auto send_result = socket.send(command.data(), command.size());
-        if (!send_result.has_value()) {
+        begin_pipeline(commands);
+    }
+
+    // continues the pipeline started with start_pipeline without waiting: sends the commands that fit into the window
+    // and handles the answers that already arrived. returns true once every command was handled, otherwise the
+    // pipeline is continued once the socket (socket_handle) is readable, or with timed_out once response_deadline
+    // passed, which drops the connection
+    template <typename Handle>
+    bool pipeline_step(Handle&& handle, bool timed_out = false) {
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        return continue_pipeline(handle, timed_out);
+    }
+
+    // drops the connection if a pipeline didn't finish, e.g. as its step threw or it was abandoned with commands in
+    // flight, their answers would be taken for the answers of the next commands
+    void abort_pipeline() {
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        end_pipeline();
+    }
+
+    // the socket that a pipeline waits on for its answers
+    SocketHandle socket_handle() const {
+        return socket.handle();
+    }
+
+    // time at which the answer that a pipeline waits for is overdue
+    std::chrono::steady_clock::time_point response_deadline() const {
+        return pipeline_deadline.value_or(std::chrono::steady_clock::time_point::max());
+    }
+
+    // like get_answer, but an answer that is younger than max_age is returned from the cache. concurrent calls with
+    // the same command share one round trip, so a command is sent only once even with a max_age of 0
+    std::optional<std::string> get_cached_answer(const std::string& command, std::chrono::milliseconds max_age) {
+        return get_cached_answers({command}, {max_age}).front();
+    }
+
+    // like get_many with the cache of get_cached_answer, max_ages holds the max age of every command
+    std::vector<std::optional<std::string>> get_cached_answers(const std::vector<std::string>& commands,
+                                                               const std::vector<std::chrono::milliseconds>& max_ages) {
+        assert(commands.size() == max_ages.size() && "every command needs a max age");
+        std::vector<std::optional<std::string>> answers(commands.size());
+        // commands that are sent by another call right now
+        std::vector<std::pair<std::size_t, std::shared_future<std::optional<std::string>>>> shared;
+        std::vector<std::size_t> sent;
+        std::vector<std::string> sent_commands;
+        std::vector<std::promise<std::optional<std::string>>> promises;
+
+        std::unique_lock<std::mutex> cache_lock(cache_mutex);
+        const auto now = std::chrono::steady_clock::now();
+        const auto generation = cache_generation;
+        std::vector<std::optional<std::string>> sent_answers;
+        try {
+            for (std::size_t i = 0; i < commands.size(); i++) {
+                const auto cached = cache.find(commands[i]);
+                if (cached != cache.end() && now - cached->second.time < max_ages[i]) {
+                    answers[i] = cached->second.answer;
+                    continue;
+                }
+                const auto pending = in_flight.find(commands[i]);
+                if (pending != in_flight.end()) {
+                    shared.emplace_back(i, pending->second);
+                    continue;
+                }
+                sent.push_back(i);
+                sent_commands.push_back(commands[i]);
+                promises.emplace_back();
+                in_flight.emplace(commands[i], promises.back().get_future().share());
+            }
+            cache_lock.unlock();
+
+            sent_answers = get_many(sent_commands);
+            cache_lock.lock();
+            for (std::size_t i = 0; i < sent.size(); i++) {
+                // an answer to a command that was sent before the cache was cleared may already be outdated
+                if (sent_answers[i].has_value() && generation == cache_generation) {
+                    cache[sent_commands[i]] = {sent_answers[i].value(), now};
+                }
+                in_flight.erase(sent_commands[i]);
+            }
+            cache_lock.unlock();
+        } catch (...) {
+            // the commands of this call are removed from in_flight on every path, calls that wait for one of them
+            // get the exception instead of waiting forever
+            if (!cache_lock.owns_lock()) {
+                cache_lock.lock();
+            }
+            for (const auto& command : sent_commands) {
+                in_flight.erase(command);
+            }
+            cache_lock.unlock();
+            for (auto& promise : promises) {
+                promise.set_exception(std::current_exception());
+            }
+            throw;
+        }
+        for (std::size_t i = 0; i < sent.size(); i++) {
+            promises[i].set_value(sent_answers[i]);
+            answers[sent[i]] = std::move(sent_answers[i]);
+        }
+        for (auto& [index, answer] : shared) {
+            answers[index] = answer.get();
+        }
+        return answers;
+    }
+
+    void clear_cache() {
+        const std::lock_guard<std::mutex> cache_lock(cache_mutex);
+        cache.clear();
+        cache_generation++;
+    }
+
+    // a batch of get_cached_answers whose commands are sent with a pipeline that is continued with pipeline_step
+    struct CachedBatch {
+        std::vector<std::optional<std::string>> answers;
+        // the commands that weren't cached and their index in answers
+        std::vector<std::string> sent_commands;
+        std::vector<std::size_t> sent;
+        std::chrono::steady_clock::time_point time;
+        std::size_t generation = 0;
+    };
+
+    // takes the answers of batch from the cache like get_cached_answers and starts a pipeline of the commands whose
+    // answers are not cached, handle_cached_answer stores their answers into batch and finish_cached_answers caches
+    // them. the commands are not shared with concurrent calls of get_cached_answers, the caller runs the batch after
+    // the other requests of the robot
+    void start_cached_answers(const std::vector<std::string>& commands,
+                              const std::vector<std::chrono::milliseconds>& max_ages, CachedBatch& batch) {
+        assert(commands.size() == max_ages.size() && "every command needs a max age");
+        batch.answers.assign(commands.size(), std::nullopt);
+        batch.sent_commands.clear();
+        batch.sent.clear();
+        {
+            const std::lock_guard<std::mutex> cache_lock(cache_mutex);
+            batch.time = std::chrono::steady_clock::now();
+            batch.generation = cache_generation;
+            for (std::size_t i = 0; i < commands.size(); i++) {
+                const auto cached = cache.find(commands[i]);
+                if (cached != cache.end() && batch.time - cached->second.time < max_ages[i]) {
+                    batch.answers[i] = cached->second.answer;
+                    continue;
+                }
+                batch.sent.push_back(i);
+                batch.sent_commands.push_back(commands[i]);
+            }
+        }
+        start_pipeline(batch.sent_commands);
+    }
+
+    static void handle_cached_answer(CachedBatch& batch, std::size_t i, std::optional<std::string_view> answer) {
+        if (answer.has_value()) {
+            batch.answers[batch.sent[i]].emplace(answer.value());
+        }
+    }
+
+    void finish_cached_answers(const CachedBatch& batch) {
+        const std::lock_guard<std::mutex> cache_lock(cache_mutex);
+        // an answer to a command that was sent before the cache was cleared may already be outdated
+        if (batch.generation != cache_generation) {
+            return;
+        }
+        for (std::size_t i = 0; i < batch.sent.size(); i++) {
+            if (batch.answers[batch.sent[i]].has_value()) {
+                cache[batch.sent_commands[i]] = {batch.answers[batch.sent[i]].value(), batch.time};
+            }
+        }
+    }
+
+    // max number of commands that get_many sends ahead of their answers, only used with a terminator
+    std::size_t max_pending_commands = 8;
+    // terminates commands and answers, e.g. a carriage return. without a terminator every command is sent on its own
+    // and its answer is the data of one receive
+    std::optional<char> terminator;
+
+   private:
+    void connect_failed() {
+#ifdef WIN32
+        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Couldn't connect to robot at address '%s:%d' %d",
+                    socket.addr, socket.port, WSAGetLastError());
+#else
+        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Couldn't connect to robot at address '%s:%d'",
+                    socket.addr, socket.port);
+#endif
+        this->disconnect();
+    }
+
+    void connection_established() {
+        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Connected with robot at address '%s:%d'", socket.addr,
+                    socket.port);
+        received_start = 0;
+        received_end = 0;
+        pipeline_running = false;
+        clear_cache();
+        connected = true;
+    }
+
+    void begin_pipeline(tcb::span<const std::string> commands) {
+        end_pipeline();
+        pipeline_commands = commands;
+        pipeline_sent = 0;
+        pipeline_received = 0;
+        pipeline_running = true;
+        pipeline_deadline = Socket::deadline(request_timeout_ms);
+    }
+
+    void end_pipeline() {
+        if (!pipeline_running) {
+            return;
+        }
+        pipeline_running = false;
+        if (connected) {
+            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Robot at address '%s:%d' has commands in flight",
+                        socket.addr, socket.port);
             this->disconnect();
-            return {};
         }
-        const auto recv_result = socket.recv(static_cast<void*>(buffer), size);
-        if (!recv_result.has_value()) {
+    }
+
+    template <typename Handle>
+    bool continue_pipeline(Handle& handle, bool timed_out) {
+        if (!pipeline_running) {
+            return true;
+        }
+        if (timed_out && connected) {
+            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Robot at address '%s:%d' didn't answer in time",
+                        socket.addr, socket.port);
             this->disconnect();
-            return {};
         }
-        UA_LOG_DEBUG(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "'%s' -> '%s'\n", command.data(), buffer);
+        // without a terminator the end of an answer is only known from the answer being the data of one receive
+        const auto max_pending = terminator.has_value() ? std::max<std::size_t>(max_pending_commands, 1) : 1;
+        const auto& commands = pipeline_commands;
+        while (pipeline_received < commands.size()) {
+            if (!connected) {
+                handle(pipeline_received++, std::optional<std::string_view>{});
+                continue;
+            }
+            send_buffer.clear();
+            for (; pipeline_sent < commands.size() && pipeline_sent - pipeline_received < max_pending;
+                 pipeline_sent++) {
+                send_buffer += commands[pipeline_sent];
+                if (terminator.has_value()) {
+                    send_buffer += terminator.value();
+                }
+            }
+            if (!send_buffer.empty() && !socket.send(send_buffer.data(), send_buffer.size()).has_value()) {
+                this->disconnect();
+                continue;
+            }
+            std::string_view answer;
+            const auto received = receive_available(answer);
+            if (received == Receive::Waiting) {
+                return false;
+            }
+            if (received == Receive::Failed) {
+                continue;
+            }
+            pipeline_deadline = Socket::deadline(request_timeout_ms);
+            handle(pipeline_received, checked_answer(commands[pipeline_received], answer));
+            pipeline_received++;
+        }
+        pipeline_running = false;
+        return true;
+    }
+
+    // the answer to command without the leading 'QoK', or nothing if the robot returned an error
+    static std::optional<std::string_view> checked_answer(const std::string& command, std::string_view answer) {
+        UA_LOG_DEBUG(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "'%s' -> '%s'\n", command.data(), answer.data());
 
-        if (strncmp(buffer, "QoK", 3) != 0 && strncmp(buffer, "Qok", 3) != 0) {
+        if (answer.compare(0, 3, "QoK") != 0 && answer.compare(0, 3, "Qok") != 0) {
             return {};
         }
-        return buffer + 3;
+        return answer.substr(3);
+    }
+
+    // receives what already arrived of the next answer into buffer without waiting for more. with a terminator several
+    // answers can arrive in one tcp segment and an answer can be split over several segments, the buffer only grows
+    // for answers that don't fit into it. a complete answer is stored in answer, null terminated after its last
+    // character
+    Receive receive_available(std::string_view& answer) {
+        return terminator.has_value() ? receive_terminated_answer(answer) : receive_single_answer(answer);
+    }
+
+    // a controller that doesn't terminate its answers sends an answer at once, so the answer is all data that arrived
+    // until nothing follows anymore. only one command is pending without a terminator, so the data can't belong to the
+    // next answer
+    Receive receive_single_answer(std::string_view& answer) {
+        while (true) {
+            if (received_end == buffer.size() - 1) {
+                buffer.resize(buffer.size() * 2);
+            }
+            const auto recv_result =
+                socket.recv_available(buffer.data() + received_end, buffer.size() - 1 - received_end);
+            if (!recv_result.has_value()) {
+                this->disconnect();
+                return Receive::Failed;
+            }
+            if (recv_result.value() == 0) {
+                if (received_end == 0) {
+                    return Receive::Waiting;
+                }
+                buffer[received_end] = '\0';
+                answer = std::string_view{buffer.data(), received_end};
+                received_end = 0;
+                return Receive::Complete;
+            }
+            received_end += static_cast<std::size_t>(recv_result.value());
+        }
+    }
+
+    // the terminator of the answer is replaced with a null character
+    Receive receive_terminated_answer(std::string_view& answer) {
+        auto end = std::find(buffer.data() + received_start, buffer.data() + received_end, terminator.value());
+        while (end == buffer.data() + received_end) {
+            if (received_start > 0) {
+                // move the beginning of the answer to the front of the buffer
+                std::memmove(buffer.data(), buffer.data() + received_start, received_end - received_start);
+                received_end -= received_start;
+                received_start = 0;
+            }
+            if (received_end == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+            const auto recv_result = socket.recv_available(buffer.data() + received_end, buffer.size() - received_end);
+            if (!recv_result.has_value()) {
+                this->disconnect();
+                return Receive::Failed;
+            }
+            if (recv_result.value() == 0) {
+                return Receive::Waiting;
+            }
+            const auto received = buffer.data() + received_end;
+            received_end += static_cast<std::size_t>(recv_result.value());
+            end = std::find(received, buffer.data() + received_end, terminator.value());
+        }
+        *end = '\0';
+        answer = std::string_view{buffer.data() + received_start,
+                                  static_cast<std::size_t>(end - (buffer.data() + received_start))};
+        received_start += answer.size() + 1;
+        return Receive::Complete;
     }
+
+    // answer of a command and the time the command was sent
+    struct CachedAnswer {
+        std::string answer;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    std::string ip_addr;
+    template <typename T>
+    static bool parse_number(std::optional<std::string_view> field, int base, T& value);
+    template <typename T>
+    static const char* parse_floating(const char* first, const char* last, T& value);
+
+    Socket socket;
+    // received data, the bytes between received_start and received_end are not handled yet
+    std::vector<char> buffer;
+    std::size_t received_start = 0;
+    std::size_t received_end = 0;
+    static constexpr std::size_t initial_buffer_size = 512;
+    std::string send_buffer;
+    // progress of the pipeline that pipeline_step continues
+    tcb::span<const std::string> pipeline_commands;
+    std::size_t pipeline_sent = 0;
+    std::size_t pipeline_received = 0;
+    bool pipeline_running = false;
+    std::optional<std::chrono::steady_clock::time_point> pipeline_deadline;
     std::mutex mutex;
+    std::mutex cache_mutex;
+    std::unordered_map<std::string, CachedAnswer> cache;
+    std::size_t cache_generation = 0;
+    std::unordered_map<std::string, std::shared_future<std::optional<std::string>>> in_flight;
 };
 
-template <>
-inline std::string R3::get<std::string>(const std::string& read_command, const std::string& match) {
-    std::string value;
-    const auto answer = get_answer(read_command);
-    if (answer.has_value()) {
-        ERROR_CONTEXT("PartialMatch", static_cast<const char*>(answer.value()));
-        ERROR_CONTEXT("\tMatch", match.c_str());
-        assert(RE2::PartialMatch(answer.value(), match, &value) && "partial match failed");
+// parses the whole captured field as an integer, like RE2 parses a capture into an integer argument
+template <typename T>
+inline bool R3::parse_number(std::optional<std::string_view> field, int base, T& value) {
+    if (!field.has_value() || field.value().empty()) {
+        return false;
     }
-    return value;
+    auto text = field.value();
+    if (text.front() == '+') {
+        text.remove_prefix(1);
+    }
+    if (base == 16 && text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        text.remove_prefix(2);
+    }
+    T parsed = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), parsed, base);
+    if (error != std::errc{} || end != text.data() + text.size()) {
+        return false;
+    }
+    value = parsed;
+    return true;
 }
 
-inline std::string R3::get(const std::string& read_command) {
-    return get_answer(read_command).value_or("");
+// parses the floating point number at the beginning of [first, last) like strtod, but without needing a null
+// terminated copy of the answer. returns the end of the number, first if there is none
+template <typename T>
+inline const char* R3::parse_floating(const char* first, const char* last, T& value) {
+    auto start = first;
+    while (start < last && std::isspace(static_cast<unsigned char>(*start))) {
+        start++;
+    }
+    if (start < last && *start == '+') {
+        start++;
+    }
+    const auto [end, error] = std::from_chars(start, last, value);
+    return error == std::errc{} ? end : first;
 }
 
-template <typename T>
-inline T R3::get_hex(const std::string& read_command, const std::string& match) {
-    const auto answer = get_answer(read_command);
-    T value = 0;
-    if (answer.has_value()) {
-        ERROR_CONTEXT("PartialMatch", static_cast<const char*>(answer.value()));
-        ERROR_CONTEXT("\tMatch", match.c_str());
-        assert(RE2::PartialMatch(answer.value(), match, RE2::Hex(&value)) && "partial match failed");
+inline std::optional<std::string_view> R3::capture(std::optional<std::string_view> answer, const Matcher& match) {
+    if (!answer.has_value()) {
+        return {};
     }
+    ERROR_CONTEXT("PartialMatch", answer.value().data());
+    ERROR_CONTEXT("\tMatch", match.pattern().c_str());
+    const auto value = match.capture(answer.value());
+    assert(value.has_value() && "partial match failed");
     return value;
 }
 
 template <>
-inline bool R3::get<bool>(const std::string& read_command, const std::string& match, int position) {
-    if (match.empty()) {
-        // if match is empty just check if any answer is returned at all
-        const auto answer = get_answer(read_command);
-        return answer.has_value() && answer.value()[0] != 0;
-    } else {
-        const auto value = this->get_hex<int32_t>(read_command, match);
-        return (value & (1 << position)) != 0;
-    }
+inline std::string R3::convert<std::string>(std::optional<std::string_view> value) {
+    return std::string{value.value_or("")};
+}
+
+template <typename T>
+inline T R3::convert_hex(std::optional<std::string_view> value) {
+    T number = 0;
+    const auto parsed = parse_number(value, 16, number);
+    assert((!value.has_value() || parsed) && "value is not a hexadecimal number");
+    static_cast<void>(parsed);
+    return number;
 }
 
 template <>
-inline double R3::get<double>(const std::string& read_command, const std::string& match) {
-    const auto value = this->get<std::string>(read_command, match);
-    return value.empty() ? 0.0 : std::stod(value, nullptr);
+inline double R3::convert<double>(std::optional<std::string_view> value) {
+    const auto text = value.value_or("");
+    double number = 0.0;
+    const auto parsed = parse_floating(text.data(), text.data() + text.size(), number) != text.data();
+    assert((text.empty() || parsed) && "value is not a number");
+    static_cast<void>(parsed);
+    return number;
 }
 
 template <>
-inline float R3::get<float>(const std::string& read_command, const std::string& match) {
-    const auto value = this->get<std::string>(read_command, match);
-    return value.empty() ? 0.0F : std::stof(value, nullptr);
+inline float R3::convert<float>(std::optional<std::string_view> value) {
+    const auto text = value.value_or("");
+    float number = 0.0F;
+    const auto parsed = parse_floating(text.data(), text.data() + text.size(), number) != text.data();
+    assert((text.empty() || parsed) && "value is not a number");
+    static_cast<void>(parsed);
+    return number;
 }
 
 template <typename Type>
-Type R3::get(const std::string& read_command, const std::string& match) {
-    const auto answer = get_answer(read_command);
-    Type value = 0;
-    if (answer.has_value()) {
-        ERROR_CONTEXT("PartialMatch", static_cast<const char*>(answer.value()));
-        ERROR_CONTEXT("\tMatch", match.c_str());
-        assert(RE2::PartialMatch(answer.value(), match, &value) && "partial match failed");
-    }
-    return value;
+Type R3::convert(std::optional<std::string_view> value) {
+    Type number = 0;
+    const auto parsed = parse_number(value, 10, number);
+    assert((!value.has_value() || parsed) && "value is not a number");
+    static_cast<void>(parsed);
+    return number;
 }
 
-inline void R3::get_position(const std::string& read_command, const std::string& match, double* array,
-                             std::size_t array_size) {
-    const auto answer = this->get<std::string>(read_command, match);
-    const char* start = answer.c_str() + 1;
-    char* end{};
+inline void R3::convert_position(std::optional<std::string_view> value, double* array, std::size_t array_size) {
+    const auto text = value.value_or("");
+    const char* last = text.data() + text.size();
+    const char* start = text.data() + 1;
     std::size_t index = 0;
-    while (start < (answer.c_str() + answer.length())) {
-        array[index] = std::strtod(start, &end);
+    while (start < last) {
+        array[index] = 0.0;
+        const char* end = parse_floating(start, last, array[index]);
+        if (end == last) {
+            return;
+        }
         start = end + 1;
         if (*end == ',') {
             index++;
@@ -213,4 +839,66 @@ inline void R3::get_position(const std::string& read_command, const std::string&
             return;
         }
     }
+}
+
+template <typename T>
+inline T R3::parse_hex(std::optional<std::string_view> answer, const Matcher& match) {
+    return convert_hex<T>(capture(answer, match));
+}
+
+inline bool R3::parse(std::optional<std::string_view> answer, const Matcher& match, int position) {
+    if (match.empty()) {
+        // if match is empty just check if any answer is returned at all
+        return answer.has_value() && !answer.value().empty();
+    } else {
+        const auto value = parse_hex<int32_t>(answer, match);
+        return (value & (1 << position)) != 0;
+    }
+}
+
+template <typename Type>
+Type R3::parse(std::optional<std::string_view> answer, const Matcher& match) {
+    return convert<Type>(capture(answer, match));
+}
+
+inline void R3::parse_position(std::optional<std::string_view> answer, const Matcher& match, double* array,
+                               std::size_t array_size) {
+    convert_position(capture(answer, match), array, array_size);
+}
+
+inline std::string R3::get(const std::string& read_command) {
+    return get_answer(read_command).value_or("");
+}
+
+// the get functions decode the answer in the receive buffer, so that the answer is never copied
+
+template <typename T>
+inline T R3::get_hex(const std::string& read_command, const Matcher& match) {
+    T value = 0;
+    pipeline({&read_command, 1},
+             [&](std::size_t, std::optional<std::string_view> answer) { value = parse_hex<T>(answer, match); });
+    return value;
+}
+
+template <>
+inline bool R3::get<bool>(const std::string& read_command, const Matcher& match, int position) {
+    bool value = false;
+    pipeline({&read_command, 1},
+             [&](std::size_t, std::optional<std::string_view> answer) { value = parse(answer, match, position); });
+    return value;
+}
+
+template <typename Type>
+Type R3::get(const std::string& read_command, const Matcher& match) {
+    Type value{};
+    pipeline({&read_command, 1},
+             [&](std::size_t, std::optional<std::string_view> answer) { value = parse<Type>(answer, match); });
+    return value;
+}
+
+inline void R3::get_position(const std::string& read_command, const Matcher& match, double* array,
+                             std::size_t array_size) {
+    pipeline({&read_command, 1}, [&](std::size_t, std::optional<std::string_view> answer) {
+        parse_position(answer, match, array, array_size);
+    });
 }
\ No newline at end of file
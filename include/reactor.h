@@ -0,0 +1,546 @@
+#pragma once
+
+#include <open62541/plugin/log_stdout.h>
+
+#ifndef WIN32
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "socket.h"
+
+// drives all device connections with a fixed number of threads instead of a thread per device. one thread waits for
+// timers, for connects to complete and for responses to arrive (with epoll), a pool of workers runs the work of the
+// devices, e.g. a step of a poll cycle. a device only occupies a thread while its work runs, so hundreds of devices
+// that mostly wait for their next poll cycle, their next connect attempt or the responses of their requests share a
+// few threads
+class Reactor {
+   public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+
+    explicit Reactor(std::size_t worker_count) {
+#ifndef WIN32
+        epoll = ::epoll_create1(EPOLL_CLOEXEC);
+        wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wakeup;
+        ::epoll_ctl(epoll, EPOLL_CTL_ADD, wakeup, &event);
+#endif
+        loop = std::thread(&Reactor::run_loop, this);
+        for (std::size_t i = 0; i < std::max<std::size_t>(worker_count, 1); i++) {
+            workers.emplace_back(&Reactor::run_worker, this);
+        }
+    }
+
+    Reactor(Reactor const&) = delete;
+    Reactor& operator=(Reactor const&) = delete;
+
+    // running tasks are finished, pending tasks are dropped
+    ~Reactor() {
+        {
+            std::scoped_lock<std::mutex> guard(mutex);
+            stopping = true;
+        }
+        task_ready.notify_all();
+        wake();
+        loop.join();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+#ifndef WIN32
+        ::close(wakeup);
+        ::close(epoll);
+#endif
+    }
+
+    // workers and the thread that waits for timers and sockets
+    std::size_t thread_count() const {
+        return workers.size() + 1;
+    }
+
+    // runs task on a worker as soon as one is free, returns false if the task is dropped because the reactor is
+    // cancelling or stopping
+    bool post(Task task) {
+        {
+            std::scoped_lock<std::mutex> guard(mutex);
+            if (stopping || draining) {
+                return false;
+            }
+            tasks.push_back(std::move(task));
+        }
+        task_ready.notify_one();
+        return true;
+    }
+
+    // runs task on a worker once time is reached
+    void schedule(Clock::time_point time, Task task) {
+        {
+            std::scoped_lock<std::mutex> guard(mutex);
+            if (stopping || draining) {
+                return;
+            }
+            timers.emplace(time, std::move(task));
+        }
+        wake();
+    }
+
+    // runs task(true) on a worker once socket is writable, i.e. once a connect started with Socket::connect_async
+    // completed or failed, or task(false) if that takes longer than timeout
+    void when_writable(SocketHandle socket, std::chrono::milliseconds timeout, std::function<void(bool)> task) {
+        watch(socket, false, Clock::now() + timeout, std::move(task));
+    }
+
+    // runs task(true) on a worker once socket has data to receive or was closed, or task(false) once deadline passed
+    // without that, so that no worker waits for the response of a device
+    void when_readable(SocketHandle socket, Clock::time_point deadline, std::function<void(bool)> task) {
+        watch(socket, true, deadline, std::move(task));
+    }
+
+    // drops all pending tasks, timers and socket watches and waits until the running tasks are finished, tasks that the
+    // running tasks post or schedule meanwhile are dropped as well. the dropped tasks are destroyed without holding the
+    // lock, as they may own state that posts a task when it is destroyed
+    void cancel_all() {
+        std::unique_lock<std::mutex> lock(mutex);
+        draining = true;
+        auto dropped_tasks = std::move(tasks);
+        auto dropped_timers = std::move(timers);
+        auto dropped_watches = std::move(watches);
+        tasks.clear();
+        timers.clear();
+        watches.clear();
+        for (const auto& [socket, _] : dropped_watches) {
+            unwatch(socket);
+        }
+        lock.unlock();
+        dropped_tasks.clear();
+        dropped_timers.clear();
+        dropped_watches.clear();
+        lock.lock();
+        idle.wait(lock, [this] { return active == 0; });
+        draining = false;
+    }
+
+   private:
+    struct Watch {
+        Clock::time_point deadline;
+        // whether the socket is watched for data to receive instead of for the end of a connect
+        bool readable;
+        std::function<void(bool)> task;
+    };
+
+    void watch(SocketHandle socket, bool readable, Clock::time_point deadline, std::function<void(bool)> task) {
+        {
+            std::scoped_lock<std::mutex> guard(mutex);
+            if (stopping || draining) {
+                return;
+            }
+#ifndef WIN32
+            epoll_event event{};
+            event.events = (readable ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+            event.data.fd = socket;
+            if (::epoll_ctl(epoll, EPOLL_CTL_ADD, socket, &event) == -1 &&
+                (errno != EEXIST || ::epoll_ctl(epoll, EPOLL_CTL_MOD, socket, &event) == -1)) {
+                tasks.emplace_back([task = std::move(task)] { task(false); });
+                task_ready.notify_one();
+                return;
+            }
+#endif
+            watches[socket] = Watch{deadline, readable, std::move(task)};
+        }
+        wake();
+    }
+
+    void wake() {
+#ifdef WIN32
+        loop_wakeup.notify_one();
+#else
+        const uint64_t one = 1;
+        static_cast<void>(::write(wakeup, &one, sizeof(one)));
+#endif
+    }
+
+    void unwatch(SocketHandle socket) {
+#ifndef WIN32
+        ::epoll_ctl(epoll, EPOLL_CTL_DEL, socket, nullptr);
+#endif
+    }
+
+    // hands a watched socket to a worker, mutex has to be held
+    void finish_watch(std::unordered_map<SocketHandle, Watch>::iterator it, bool ready) {
+        unwatch(it->first);
+        tasks.emplace_back([task = std::move(it->second.task), ready] { task(ready); });
+        task_ready.notify_one();
+        watches.erase(it);
+    }
+
+    void run_loop() {
+#ifndef WIN32
+        std::vector<epoll_event> events(64);
+#endif
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            // due timers and watches that timed out are handed to the workers
+            const auto now = Clock::now();
+            while (!timers.empty() && timers.begin()->first <= now) {
+                tasks.push_back(std::move(timers.begin()->second));
+                timers.erase(timers.begin());
+                task_ready.notify_one();
+            }
+            auto next = timers.empty() ? now + std::chrono::hours(1) : timers.begin()->first;
+            for (auto it = watches.begin(); it != watches.end();) {
+                if (it->second.deadline <= now) {
+                    finish_watch(it++, false);
+                } else {
+                    next = std::min(next, it->second.deadline);
+                    it++;
+                }
+            }
+            const auto timeout =
+                std::chrono::ceil<std::chrono::milliseconds>(std::max(next - now, Clock::duration::zero()));
+
+#ifdef WIN32
+            // without epoll the watched sockets are polled, a wakeup only interrupts waiting without watched sockets
+            std::vector<WSAPOLLFD> sockets;
+            for (const auto& [socket, watch] : watches) {
+                sockets.push_back(WSAPOLLFD{socket, watch.readable ? POLLRDNORM : POLLWRNORM, 0});
+            }
+            if (sockets.empty()) {
+                loop_wakeup.wait_for(lock, timeout);
+                continue;
+            }
+            lock.unlock();
+            const auto poll_timeout = std::min<std::chrono::milliseconds::rep>(timeout.count(), 10);
+            const auto count =
+                ::WSAPoll(sockets.data(), static_cast<ULONG>(sockets.size()), static_cast<INT>(poll_timeout));
+            lock.lock();
+            for (std::size_t i = 0; count > 0 && i < sockets.size(); i++) {
+                const auto it = watches.find(sockets[i].fd);
+                if (sockets[i].revents != 0 && it != watches.end()) {
+                    finish_watch(it, true);
+                }
+            }
+#else
+            lock.unlock();
+            const auto count = ::epoll_wait(epoll, events.data(), static_cast<int>(events.size()),
+                                            static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+                                                timeout.count(), std::numeric_limits<int>::max())));
+            lock.lock();
+            for (int i = 0; i < count; i++) {
+                const auto socket = events[static_cast<std::size_t>(i)].data.fd;
+                if (socket == wakeup) {
+                    uint64_t value = 0;
+                    static_cast<void>(::read(wakeup, &value, sizeof(value)));
+                    continue;
+                }
+                // errors and hang ups are reported as ready, finish_connect finds out whether the connect failed and
+                // a receive whether the device closed the connection
+                const auto it = watches.find(socket);
+                if (it != watches.end()) {
+                    finish_watch(it, true);
+                }
+            }
+#endif
+        }
+    }
+
+    void run_worker() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            task_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping) {
+                return;
+            }
+            auto task = std::move(tasks.front());
+            tasks.pop_front();
+            active++;
+            lock.unlock();
+            try {
+                task();
+            } catch (...) {
+                UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Device task threw an exception");
+            }
+            // the task is destroyed before it counts as finished, it may own state of a device
+            task = nullptr;
+            lock.lock();
+            active--;
+            if (active == 0) {
+                idle.notify_all();
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::condition_variable idle;
+    std::deque<Task> tasks;
+    std::multimap<Clock::time_point, Task> timers;
+    std::unordered_map<SocketHandle, Watch> watches;
+    std::size_t active = 0;
+    bool stopping = false;
+    bool draining = false;
+#ifdef WIN32
+    std::condition_variable loop_wakeup;
+#else
+    int epoll;
+    // written to interrupt epoll_wait when a timer or a watch was added
+    int wakeup;
+#endif
+    std::thread loop;
+    std::vector<std::thread> workers;
+};
+
+// runs the parts of a batch in parallel, part 0 on the calling thread and the other parts on the workers of a reactor,
+// e.g. the requests of a poll cycle that are spread over several connections. the calling thread runs the parts that no
+// worker started yet itself, so a worker that runs a batch never waits for a free worker. without a reactor all parts
+// run one after another on the calling thread. kept by its owner between the batches, so that a batch doesn't allocate,
+// and has to outlive the tasks it posted to the reactor
+class ParallelBatch {
+   public:
+    ParallelBatch() = default;
+    ParallelBatch(ParallelBatch const&) = delete;
+    ParallelBatch& operator=(ParallelBatch const&) = delete;
+
+    // returns once part(i) returned for every i below count, only one batch runs at a time
+    template <typename Part>
+    void run(Reactor* reactor, std::size_t count, Part& part) {
+        std::unique_lock<std::mutex> lock(mutex);
+        context = &part;
+        call = [](void* part_context, std::size_t i) { (*static_cast<Part*>(part_context))(i); };
+        next = 1;
+        size = count;
+        const auto batch = ++generation;
+        lock.unlock();
+        for (std::size_t i = 1; reactor != nullptr && i < count; i++) {
+            reactor->post([this, batch] { help(batch); });
+        }
+        if (count > 0) {
+            part(0);
+        }
+        help(batch);
+        lock.lock();
+        finished.wait(lock, [this] { return running == 0; });
+    }
+
+   private:
+    // runs the parts of batch that didn't start yet, a task of a previous batch finds nothing to do
+    void help(uint64_t batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (batch == generation && next < size) {
+            const auto i = next++;
+            running++;
+            lock.unlock();
+            call(context, i);
+            lock.lock();
+            running--;
+        }
+        if (running == 0) {
+            finished.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    void* context = nullptr;
+    void (*call)(void*, std::size_t) = nullptr;
+    uint64_t generation = 0;
+    std::size_t next = 0;
+    std::size_t size = 0;
+    std::size_t running = 0;
+};
+
+// runs the device i/o of a device on the workers of a reactor, one task after another in the order they were pushed,
+// e.g. its poll cycles and the reads and writes that the opc ua callbacks hand off. without a reactor the tasks run
+// right away on the thread that pushes them
+class DeviceQueue {
+   public:
+    using AsyncTask = std::function<void(Reactor::Task)>;
+
+    DeviceQueue() = default;
+    DeviceQueue(DeviceQueue const&) = delete;
+    DeviceQueue& operator=(DeviceQueue const&) = delete;
+
+    // reactor has to outlive the queue, or the tasks of the queue have to be cancelled first. tasks pushed after
+    // detaching with nullptr run on the caller
+    void attach(Reactor* new_reactor) {
+        std::scoped_lock<std::mutex> guard(mutex);
+        reactor = new_reactor;
+    }
+
+    // drops the queued tasks, after Reactor::cancel_all dropped the task that would have run them. an async task that
+    // didn't finish yet doesn't hold back the tasks pushed afterwards anymore
+    void cancel() {
+        std::scoped_lock<std::mutex> guard(mutex);
+        tasks.clear();
+        draining = false;
+        async_generation++;
+    }
+
+    void push(Reactor::Task task) {
+        push_entry(Entry{std::move(task), nullptr});
+    }
+
+    // like push, but task(done) may finish after it returned, e.g. once the responses that it waits for with the
+    // reactor arrived, the tasks after it wait until it called done. dropping every copy of done without calling it,
+    // e.g. as the reactor was cancelled or the task threw, counts as calling it
+    void push_async(AsyncTask task) {
+        push_entry(Entry{nullptr, std::move(task)});
+    }
+
+    // runs function in order with the other tasks of the queue and waits at most timeout_ms for its result, 0 waits
+    // until it ran. returns nothing if function didn't finish in time or was dropped, it may still run afterwards
+    template <typename Function>
+    auto call(Function function, int timeout_ms) -> std::optional<decltype(function())> {
+        auto promise = std::make_shared<std::promise<decltype(function())>>();
+        auto result = promise->get_future();
+        push([promise, function]() { promise->set_value(function()); });
+        if (timeout_ms > 0 && result.wait_for(std::chrono::milliseconds(timeout_ms)) != std::future_status::ready) {
+            return {};
+        }
+        try {
+            return result.get();
+        } catch (const std::future_error&) {
+            // the task was dropped or threw, which destroyed the promise without a result
+            return {};
+        }
+    }
+
+   private:
+    struct Entry {
+        Reactor::Task task;
+        AsyncTask async_task;
+    };
+
+    // continues the queue once the async task of generation called done or dropped every copy of it
+    class Completion {
+       public:
+        Completion(DeviceQueue* owner, uint64_t started) : queue{owner}, generation{started} {}
+        Completion(Completion const&) = delete;
+        Completion& operator=(Completion const&) = delete;
+
+        ~Completion() {
+            finish();
+        }
+
+        void finish() {
+            if (!finished.exchange(true)) {
+                queue->resume(generation);
+            }
+        }
+
+       private:
+        DeviceQueue* queue;
+        uint64_t generation;
+        std::atomic<bool> finished{false};
+    };
+
+    void push_entry(Entry entry) {
+        {
+            std::scoped_lock<std::mutex> guard(mutex);
+            if (reactor != nullptr) {
+                if (draining) {
+                    tasks.push_back(std::move(entry));
+                } else if (reactor->post([this] { drain(); })) {
+                    tasks.push_back(std::move(entry));
+                    draining = true;
+                }
+                // the task is dropped while the reactor is cancelling or stopping
+                return;
+            }
+        }
+        run(entry, [] {});
+    }
+
+    static void run(Entry& entry, Reactor::Task done) {
+        try {
+            if (entry.async_task) {
+                entry.async_task(std::move(done));
+            } else {
+                entry.task();
+            }
+        } catch (...) {
+            UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Device task threw an exception");
+        }
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!tasks.empty()) {
+            auto entry = std::move(tasks.front());
+            tasks.pop_front();
+            if (entry.async_task) {
+                // the queue stays draining until the task is done, resume continues it
+                const auto completion = std::make_shared<Completion>(this, ++async_generation);
+                lock.unlock();
+                run(entry, [completion] { completion->finish(); });
+                return;
+            }
+            lock.unlock();
+            run(entry, nullptr);
+            entry = {};
+            lock.lock();
+        }
+        draining = false;
+    }
+
+    void resume(uint64_t generation) {
+        std::scoped_lock<std::mutex> guard(mutex);
+        if (generation != async_generation || !draining) {
+            // the queue was cancelled since the task started
+            return;
+        }
+        if (tasks.empty() || reactor == nullptr || !reactor->post([this] { drain(); })) {
+            draining = false;
+        }
+    }
+
+    std::mutex mutex;
+    Reactor* reactor = nullptr;
+    std::deque<Entry> tasks;
+    bool draining = false;
+    // counts the async tasks that started, so that a task that finishes after the queue was cancelled is ignored
+    uint64_t async_generation = 0;
+};
+
+// continues a pipeline of connection (an SLMP or R3 connection) each time its socket becomes readable: step(timed_out)
+// handles the responses that arrived and sends the next requests without waiting, it returns true once every request
+// of the pipeline was handled, then finished is called. a step that throws drops the connection with the requests in
+// flight, which finishes the pipeline like a lost connection
+template <typename Connection, typename Step, typename Finished>
+void drive_pipeline(Reactor& reactor, Connection& connection, Step step, Finished finished, bool timed_out = false) {
+    bool done = true;
+    try {
+        done = step(timed_out);
+    } catch (...) {
+        UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Device pipeline threw an exception");
+        connection.abort_pipeline();
+    }
+    if (done) {
+        finished();
+        return;
+    }
+    reactor.when_readable(connection.socket_handle(), connection.response_deadline(),
+                          [&reactor, &connection, step, finished](bool readable) {
+                              drive_pipeline(reactor, connection, step, finished, !readable);
+                          });
+}
\ No newline at end of file
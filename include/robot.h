@@ -6,60 +6,196 @@
 #include <open62541/types.h>
 #include <open62541/types_generated.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <filesystem>
 #include <fstream>
 #include <iterator>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "r3.h"
 #include "wrapper.h"
 
+class RobotAnswers;
+struct RobotNode;
+
+// decodes the answers of the robot into the value of a node, resolved from the datatype when the node is created. the
+// value is built in arena and borrows strings from the answers, so it is only valid until both are dropped
+using RobotDecoder = void (*)(const RobotNode* node, const R3::Matcher& match, const std::vector<std::size_t>& indices,
+                              RobotAnswers& answers, ScratchArena& arena, UA_Variant* value);
+
 struct RobotNode {
     UA_NodeId node;
     std::vector<RobotNode> children;
     std::optional<R3::Command> read_command;
     std::optional<R3::Command> write_command;
     std::size_t count;
-    std::string datatype;
+    RobotDecoder decode;
     std::string name;
 
-    explicit RobotNode(UA_NodeId node) : node{node}, count{0} {}
+    explicit RobotNode(UA_NodeId node) : node{node}, count{0}, decode{nullptr} {}
 
-    RobotNode const* get_node(UA_UInt16 namespace_id, UA_UInt32 identifier) const {
-        for (const auto& child_node : children) {
-            if (child_node.node.namespaceIndex == namespace_id &&
-                child_node.node.identifierType == UA_NODEIDTYPE_NUMERIC &&
-                child_node.node.identifier.numeric == identifier) {
-                return &child_node;
-            }
+    [[nodiscard]] RobotNode* contains(const std::string& child_name) {
+        // children are only ever appended, so only the children added since the last lookup are indexed
+        for (; indexed_children < children.size(); indexed_children++) {
+            child_indices.emplace(children[indexed_children].name, indexed_children);
         }
-        for (const auto& child_node : children) {
-            const auto result = child_node.get_node(namespace_id, identifier);
-            if (result != nullptr) {
-                return result;
-            }
+        const auto it = child_indices.find(child_name);
+        return (it != child_indices.end()) ? &children[it->second] : nullptr;
+    }
+
+   private:
+    std::unordered_map<std::string, std::size_t> child_indices;
+    std::size_t indexed_children = 0;
+};
+
+// node of the robot specification, compiled once from the json so that creating the nodes of a robot doesn't access
+// the json. commands and names are formatted with the arguments of every created node
+struct RobotNodeTemplate {
+    enum class Type { Folder, Object, Property, EnumProperty, Value };
+    // how the count of a folder is decoded from the answer of its count command
+    enum class CountDatatype { BitCount, HexUInt, UInt };
+
+    struct Command {
+        std::string command;
+        std::string match;
+        std::chrono::milliseconds max_age;
+    };
+
+    Type type;
+    std::string name;
+    // folder: object type of the node, count of its child, either fixed or read from the robot
+    bool folder = true;
+    uint32_t count = 0;
+    std::optional<Command> count_command;
+    CountDatatype count_datatype = CountDatatype::UInt;
+    // object: only created if the condition matches
+    std::optional<Command> condition;
+    // property: either a fixed value or read with read_command
+    std::optional<std::string> value;
+    std::optional<Command> read_command;
+    // enum property and value
+    std::vector<std::tuple<std::string, std::string, int64_t>> cases;
+    std::optional<R3::CaseSet> case_set;
+    std::pair<std::string, int64_t> default_case;
+    // value
+    std::string datatype;
+    RobotDecoder decode = nullptr;
+    std::optional<std::string> write_command;
+    // the single child of a folder, or the children of an object
+    std::vector<RobotNodeTemplate> children;
+};
+
+// distinct robot commands needed to read a set of nodes, each answer is decoded into every node that uses it
+struct RobotReadPlan {
+    struct Target {
+        const RobotNode* node;
+        R3::Matcher match;
+        // index into commands, one per array element
+        std::vector<std::size_t> answers;
+    };
+
+    std::vector<std::string> commands;
+    // max age of a cached answer per command, the smallest max age of all nodes that use the command
+    std::vector<std::chrono::milliseconds> max_ages;
+    std::vector<Target> targets;
+};
+
+// answers of the robot, every answer is split into its semicolon separated fields at most once and the fields are
+// shared by all nodes that capture a field of the same answer
+class RobotAnswers {
+   public:
+    RobotAnswers() = default;
+
+    explicit RobotAnswers(std::vector<std::optional<std::string>> received) {
+        for (auto& answer : received) {
+            add(std::move(answer));
         }
-        return nullptr;
     }
 
-    [[nodiscard]] RobotNode* contains(const std::string child_name) {
-        for (std::size_t i = 0; i < children.size(); i++) {
-            if (children[i].name == child_name) {
-                return &children[i];
+    std::size_t add(std::optional<std::string> answer) {
+        answers.push_back(std::move(answer));
+        fields.emplace_back();
+        return answers.size() - 1;
+    }
+
+    const std::optional<std::string>& answer(std::size_t index) const {
+        return answers[index];
+    }
+
+    // returns the value that match captures from the answer, or nothing if the robot returned no answer
+    std::optional<std::string_view> capture(std::size_t index, const R3::Matcher& match) {
+        const auto& answer = answers[index];
+        if (!answer.has_value()) {
+            return {};
+        }
+        const auto field = match.captured_field();
+        if (field.has_value()) {
+            auto& split = fields[index];
+            if (!split.has_value()) {
+                split = R3::split_fields(answer.value());
+            }
+            if (field.value() < split->size()) {
+                return split->at(field.value());
             }
         }
-        return nullptr;
+        return R3::capture(answer.value(), match);
     }
+
+    void clear() {
+        answers.clear();
+        fields.clear();
+    }
+
+   private:
+    // deques, so that the fields stay valid when answers are added
+    std::deque<std::optional<std::string>> answers;
+    std::deque<std::optional<std::vector<std::string_view>>> fields;
+};
+
+// a value of an answer that the structure of the robot was discovered from, the structure is unchanged as long as
+// every check has the same result
+struct RobotStructureCheck {
+    std::string command;
+    // compiled once when the check is recorded, the checks are evaluated again after every reconnect
+    R3::Matcher match;
+    // a condition only checks whether match matches the answer, all other checks compare the captured value
+    bool condition;
+    std::optional<std::string> result;
 };
 
 struct Robot : public Client {
     std::string name;
     R3 r3;
     RobotNode node;
+    std::vector<const RobotNode*> polled_nodes;
+    // all nodes of the robot by their numeric node id
+    std::unordered_map<UA_UInt32, const RobotNode*> indexed_nodes;
+    RobotReadPlan poll_plan;
+    // commands of the poll cycle that poll_robot_async sends, kept until their answers arrived
+    R3::CachedBatch poll_batch;
+    // answers of the commands sent while the nodes are created, each command is only sent for the first node that
+    // needs it
+    RobotAnswers discovery_answers;
+    std::unordered_map<std::string, std::size_t> discovery_commands;
+    // if the discovery answers are stored on disk per controller, so that a reconnect doesn't repeat the discovery
+    bool cache_structure = true;
+    std::vector<RobotStructureCheck> structure_checks;
+    // scratch space for the decoded values, the poller and a read on a shadow miss may decode at the same time
+    ScratchArena arena;
+    std::mutex arena_mutex;
 
     Robot(std::string name, std::string ip, int port) : name{std::move(name)}, r3(std::move(ip), port), node{{}} {}
 
@@ -77,11 +213,73 @@ auto format_read_command(const R3::Command& read_command, std::size_t j = 0) ->
                         fmt::arg("i3", 3 * (read_command.id - 1)))};
 }
 
+// renders the read commands of a node once, one per array element for array nodes, and compiles its match
+inline void render_read_command(R3::Command& read_command, const std::string& datatype, uint32_t count) {
+    read_command.rendered.clear();
+    if (count == 0 || datatype == "Position" || datatype == "Joint") {
+        read_command.rendered.push_back(format_read_command(read_command).first);
+    } else {
+        for (std::size_t j = 1; j <= count; j++) {
+            read_command.rendered.push_back(format_read_command(read_command, j).first);
+        }
+    }
+    read_command.matcher = format_read_command(read_command).second;
+}
+
+// stands in for the value while a write command is rendered, collects the format of the value
+struct WriteValue {
+    std::vector<std::string>* formats;
+};
+
+template <>
+struct fmt::formatter<WriteValue> {
+    std::string format_spec;
+
+    auto parse(format_parse_context& context) {
+        auto it = context.begin();
+        while (it != context.end() && *it != '}') {
+            it++;
+        }
+        format_spec.assign(context.begin(), it);
+        return it;
+    }
+
+    auto format(const WriteValue& value, format_context& context) const {
+        value.formats->push_back("{:" + format_spec + "}");
+        // marks where the value is inserted
+        *context.out() = '\0';
+        return context.out();
+    }
+};
+
+// renders the write command of a node once, only the value is formatted on every write
+inline void render_write_command(R3::Command& write_command) {
+    write_command.value_formats.clear();
+    const auto command =
+        fmt::format("{};{};{}", write_command.mecha_no, write_command.task_slot_no,
+                    fmt::format(fmt::runtime(write_command.command), fmt::arg("i", write_command.id),
+                                fmt::arg("i16", 16 * (write_command.id - 1)),
+                                fmt::arg("value", WriteValue{&write_command.value_formats})));
+    write_command.rendered.clear();
+    std::size_t start = 0;
+    while (true) {
+        const auto end = command.find('\0', start);
+        write_command.rendered.push_back(command.substr(start, end - start));
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+}
+
 template <typename T>
 auto format_write_command(const R3::Command& write_command, T value) -> std::string {
-    return fmt::format("{};{};{}", write_command.mecha_no, write_command.task_slot_no,
-                       fmt::format(fmt::runtime(write_command.command), fmt::arg("i", write_command.id),
-                                   fmt::arg("i16", 16 * (write_command.id - 1)), fmt::arg("value", value)));
+    std::string command = write_command.rendered.front();
+    for (std::size_t i = 0; i < write_command.value_formats.size(); i++) {
+        fmt::format_to(std::back_inserter(command), fmt::runtime(write_command.value_formats[i]), value);
+        command += write_command.rendered[i + 1];
+    }
+    return command;
 }
 
 auto format_name(const std::string& name, uint16_t id) -> std::string {
@@ -89,70 +287,291 @@ auto format_name(const std::string& name, uint16_t id) -> std::string {
                        fmt::arg("last16", id * 16 - 1));
 }
 
-static UA_StatusCode read_robot_value(UA_Server* server, const UA_NodeId* sessionId, void* sessionContext,
-                                      const UA_NodeId* nodeId, void* nodeContext, UA_Boolean sourceTimeStamp,
-                                      const UA_NumericRange* range, UA_DataValue* dataValue) {
-    auto robot = static_cast<Robot*>(nodeContext);
-    const RobotNode* node;
-    if (robot && (node = robot->node.get_node(nodeId->namespaceIndex, nodeId->identifier.numeric)) != nullptr &&
-        node->read_command.has_value()) {
-        if (!robot->r3.connected) {
-            return UA_STATUSCODE_BADDEVICEFAILURE;
-        }
-        const auto id = node->read_command.value().id;
-        const auto [read_command, match] = format_read_command(node->read_command.value());
-        if (node->datatype == "Double") {
-            auto value = robot->r3.get<double>(read_command, match);
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
-        } else if (node->datatype == "Float") {
-            auto value = robot->r3.get<float>(read_command, match);
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_FLOAT]);
-        } else if (node->datatype == "Int32") {
-            auto value = robot->r3.get<int32_t>(read_command, match);
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_INT32]);
-        } else if (node->datatype == "HexInt32") {
-            auto value = robot->r3.get_hex<int32_t>(read_command, match);
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_INT32]);
-        } else if (node->datatype == "Int64") {
-            auto value = robot->r3.get<int64_t>(read_command, match);
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_INT64]);
-        } else if (node->datatype == "UInt32") {
-            auto value = robot->r3.get<uint32_t>(read_command, match);
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_UINT32]);
-        } else if (node->datatype == "UInt64") {
-            auto value = robot->r3.get<uint64_t>(read_command, match);
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_UINT64]);
-        } else if (node->datatype == "Bool") {
-            auto value = robot->r3.get<bool>(read_command, match, node->read_command.value().position);
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_BOOLEAN]);
-        } else if (node->datatype == "String") {
-            auto data = robot->r3.get<std::string>(read_command, match);
-            auto value = UA_STRING(data.data());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_STRING]);
-        } else if (node->datatype == "LocalizedText") {
-            auto data = robot->r3.get<std::string>(read_command, match);
-            auto value = UA_LOCALIZEDTEXT(locale, data.data());
-            UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
-        } else if (node->datatype == "Enum") {
-            auto data = robot->r3.get<std::string>(read_command, match);
-            std::string enum_string;
-            int64_t enum_value = -1;
-            for (const auto& tuple : node->read_command->cases) {
-                if ((std::get<0>(tuple) == "Default" && enum_value == -1) ||
-                    RE2::PartialMatch(data, std::get<0>(tuple))) {
-                    enum_string = std::get<1>(tuple);
-                    enum_value = std::get<2>(tuple);
-                }
-            }
-            auto value = Datatype<UA_EnumValueType>(enum_value, enum_string);
-            UA_Variant_setScalarCopy(&dataValue->value, &value.value, &UA_TYPES[UA_TYPES_ENUMVALUETYPE]);
+inline RobotReadPlan plan_robot_reads(const std::vector<const RobotNode*>& nodes) {
+    RobotReadPlan plan;
+    std::unordered_map<std::string, std::size_t> command_indices;
+    const auto add_command = [&](std::string command, std::chrono::milliseconds max_age) {
+        const auto [it, inserted] = command_indices.try_emplace(command, plan.commands.size());
+        if (inserted) {
+            plan.commands.push_back(std::move(command));
+            plan.max_ages.push_back(max_age);
         } else {
-            throw std::runtime_error{"Invalid data type"};
+            plan.max_ages[it->second] = std::min(plan.max_ages[it->second], max_age);
+        }
+        return it->second;
+    };
+
+    for (const auto node : nodes) {
+        RobotReadPlan::Target target{node, node->read_command->matcher, {}};
+        for (const auto& command : node->read_command->rendered) {
+            target.answers.push_back(add_command(command, node->read_command->max_age));
+        }
+        plan.targets.push_back(std::move(target));
+    }
+    return plan;
+}
+
+// string that points into the captured text of an answer, empty without a captured text
+inline UA_String borrow_robot_string(std::optional<std::string_view> capture) {
+    const auto text = capture.value_or(std::string_view{""});
+    return UA_String{text.size(), reinterpret_cast<UA_Byte*>(const_cast<char*>(text.data()))};
+}
+
+template <typename Type, std::size_t UAType>
+void decode_robot_scalar(const RobotNode* node, const R3::Matcher& match, const std::vector<std::size_t>& indices,
+                         RobotAnswers& answers, ScratchArena& arena, UA_Variant* value) {
+    const auto data = arena.allocate<Type>(1);
+    *data = R3::convert<Type>(answers.capture(indices[0], match));
+    borrow_scalar(value, data, &UA_TYPES[UAType]);
+}
+
+inline void decode_robot_hex(const RobotNode* node, const R3::Matcher& match, const std::vector<std::size_t>& indices,
+                             RobotAnswers& answers, ScratchArena& arena, UA_Variant* value) {
+    const auto data = arena.allocate<int32_t>(1);
+    *data = R3::convert_hex<int32_t>(answers.capture(indices[0], match));
+    borrow_scalar(value, data, &UA_TYPES[UA_TYPES_INT32]);
+}
+
+inline void decode_robot_bool(const RobotNode* node, const R3::Matcher& match, const std::vector<std::size_t>& indices,
+                              RobotAnswers& answers, ScratchArena& arena, UA_Variant* value) {
+    const auto data = arena.allocate<UA_Boolean>(1);
+    *data = R3::parse(answers.answer(indices[0]), match, node->read_command.value().position);
+    borrow_scalar(value, data, &UA_TYPES[UA_TYPES_BOOLEAN]);
+}
+
+inline void decode_robot_string(const RobotNode* node, const R3::Matcher& match,
+                                const std::vector<std::size_t>& indices, RobotAnswers& answers, ScratchArena& arena,
+                                UA_Variant* value) {
+    const auto data = arena.allocate<UA_String>(1);
+    *data = borrow_robot_string(answers.capture(indices[0], match));
+    borrow_scalar(value, data, &UA_TYPES[UA_TYPES_STRING]);
+}
+
+inline void decode_robot_text(const RobotNode* node, const R3::Matcher& match, const std::vector<std::size_t>& indices,
+                              RobotAnswers& answers, ScratchArena& arena, UA_Variant* value) {
+    const auto data = arena.allocate<UA_LocalizedText>(1);
+    data->locale = UA_STRING(locale);
+    data->text = borrow_robot_string(answers.capture(indices[0], match));
+    borrow_scalar(value, data, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+}
+
+inline void decode_robot_enum(const RobotNode* node, const R3::Matcher& match, const std::vector<std::size_t>& indices,
+                              RobotAnswers& answers, ScratchArena& arena, UA_Variant* value) {
+    const auto capture = answers.capture(indices[0], match).value_or(std::string_view{""});
+    static const std::string no_case;
+    const std::string* enum_string = &no_case;
+    int64_t enum_value = -1;
+    const auto& cases = node->read_command->cases;
+    const auto matching = node->read_command->case_set.has_value() ? node->read_command->case_set->match(capture)
+                                                                    : std::vector<bool>(cases.size(), false);
+    for (std::size_t i = 0; i < cases.size(); i++) {
+        const auto& tuple = cases[i];
+        if ((std::get<0>(tuple) == "Default" && enum_value == -1) || matching[i]) {
+            enum_string = &std::get<1>(tuple);
+            enum_value = std::get<2>(tuple);
+        }
+    }
+    // the display name points into the cases of the node
+    const auto data = arena.allocate<UA_EnumValueType>(1);
+    data->value = enum_value;
+    data->displayName.locale = UA_STRING(locale);
+    data->description.locale = UA_STRING(locale);
+    data->displayName.text = borrow_robot_string(*enum_string);
+    data->description.text = borrow_robot_string(std::string_view{""});
+    borrow_scalar(value, data, &UA_TYPES[UA_TYPES_ENUMVALUETYPE]);
+}
+
+// a position has 10 and a joint 8 elements
+template <std::size_t Size>
+void decode_robot_position(const RobotNode* node, const R3::Matcher& match, const std::vector<std::size_t>& indices,
+                           RobotAnswers& answers, ScratchArena& arena, UA_Variant* value) {
+    const auto position = arena.allocate<double>(Size);
+    R3::convert_position(answers.capture(indices[0], match), position, Size);
+    borrow_array(value, position, Size, &UA_TYPES[UA_TYPES_DOUBLE]);
+}
+
+// every element of an array is read with a command of its own
+template <typename Type, std::size_t UAType>
+void decode_robot_array(const RobotNode* node, const R3::Matcher& match, const std::vector<std::size_t>& indices,
+                        RobotAnswers& answers, ScratchArena& arena, UA_Variant* value) {
+    if constexpr (std::is_same_v<Type, std::string>) {
+        const auto strings = arena.allocate<UA_String>(node->count);
+        for (std::size_t i = 0; i < node->count; i++) {
+            strings[i] = borrow_robot_string(answers.capture(indices[i], match));
         }
+        borrow_array(value, strings, node->count, &UA_TYPES[UAType]);
     } else {
-        double value = 0;
-        UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+        const auto values = arena.allocate<Type>(node->count);
+        for (std::size_t i = 0; i < node->count; i++) {
+            values[i] = R3::convert<Type>(answers.capture(indices[i], match));
+        }
+        borrow_array(value, values, node->count, &UA_TYPES[UAType]);
+    }
+}
+
+// returns the decoder of datatype for a node with count array elements, nullptr if the datatype isn't supported
+inline RobotDecoder robot_decoder(const std::string& datatype, uint32_t count) {
+    if (count == 0) {
+        if (datatype == "Double") {
+            return decode_robot_scalar<double, UA_TYPES_DOUBLE>;
+        } else if (datatype == "Float") {
+            return decode_robot_scalar<float, UA_TYPES_FLOAT>;
+        } else if (datatype == "Int32") {
+            return decode_robot_scalar<int32_t, UA_TYPES_INT32>;
+        } else if (datatype == "HexInt32") {
+            return decode_robot_hex;
+        } else if (datatype == "Int64") {
+            return decode_robot_scalar<int64_t, UA_TYPES_INT64>;
+        } else if (datatype == "UInt32") {
+            return decode_robot_scalar<uint32_t, UA_TYPES_UINT32>;
+        } else if (datatype == "UInt64") {
+            return decode_robot_scalar<uint64_t, UA_TYPES_UINT64>;
+        } else if (datatype == "Bool") {
+            return decode_robot_bool;
+        } else if (datatype == "String") {
+            return decode_robot_string;
+        } else if (datatype == "LocalizedText") {
+            return decode_robot_text;
+        } else if (datatype == "Enum") {
+            return decode_robot_enum;
+        }
+    } else if (datatype == "Position") {
+        return decode_robot_position<10>;
+    } else if (datatype == "Joint") {
+        return decode_robot_position<8>;
+    } else if (datatype == "Double") {
+        return decode_robot_array<double, UA_TYPES_DOUBLE>;
+    } else if (datatype == "Int32") {
+        return decode_robot_array<int32_t, UA_TYPES_INT32>;
+    } else if (datatype == "String") {
+        return decode_robot_array<std::string, UA_TYPES_STRING>;
+    }
+    return nullptr;
+}
+
+// decodes the answers to the commands of the plan into the shadow values of all nodes of the plan
+inline void update_robot_reads(Robot* robot, const RobotReadPlan& plan, RobotAnswers& answers) {
+    const std::lock_guard<std::mutex> lock(robot->arena_mutex);
+    for (const auto& target : plan.targets) {
+        robot->arena.reset();
+        UA_Variant value;
+        UA_Variant_init(&value);
+        target.node->decode(target.node, target.match, target.answers, answers, robot->arena, &value);
+        robot->shadow.store(target.node->node.identifier.numeric, &value,
+                            robot->r3.connected ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDEVICEFAILURE);
+    }
+}
+
+// sends every command of the plan once as one pipelined batch, unless a recent enough answer is cached, and updates
+// the shadow values of all nodes of the plan
+inline void execute_robot_reads(Robot* robot, const RobotReadPlan& plan) {
+    if (!robot->r3.connected) {
+        return;
+    }
+    RobotAnswers answers{robot->r3.get_cached_answers(plan.commands, plan.max_ages)};
+    update_robot_reads(robot, plan, answers);
+}
+
+// refreshes the shadow values of all polled nodes of the robot
+inline void poll_robot(Robot* robot) {
+    execute_robot_reads(robot, robot->poll_plan);
+}
+
+// like poll_robot, but the reactor waits for the answers of the robot instead of a worker, so that a robot that went
+// silent doesn't occupy a worker. finished is called once the shadow values of all polled nodes are updated, the
+// robot is polled right away without a reactor
+template <typename Finished>
+void poll_robot_async(Robot* robot, Finished finished) {
+    if (robot->reactor == nullptr || !robot->r3.connected) {
+        poll_robot(robot);
+        finished();
+        return;
+    }
+    robot->r3.start_cached_answers(robot->poll_plan.commands, robot->poll_plan.max_ages, robot->poll_batch);
+    drive_pipeline(
+        *robot->reactor, robot->r3,
+        [robot](bool timed_out) {
+            return robot->r3.pipeline_step(
+                [robot](std::size_t i, std::optional<std::string_view> answer) {
+                    R3::handle_cached_answer(robot->poll_batch, i, answer);
+                },
+                timed_out);
+        },
+        [robot, finished] {
+            auto& batch = robot->poll_batch;
+            robot->r3.finish_cached_answers(batch);
+            RobotAnswers answers{std::move(batch.answers)};
+            update_robot_reads(robot, robot->poll_plan, answers);
+            finished();
+        });
+}
+
+// reads all nodes of the robot without a shadow value in one batch, the caller holds nodes_mutex shared
+inline void read_missing_robot_values(Robot* robot) {
+    std::vector<const RobotNode*> missing;
+    for (const auto polled_node : robot->polled_nodes) {
+        if (!robot->shadow.contains(polled_node->node.identifier.numeric)) {
+            missing.push_back(polled_node);
+        }
+    }
+    execute_robot_reads(robot, plan_robot_reads(missing));
+}
+
+// serves a read from the shadow store, on a miss all nodes of the robot without a value are read in one batch,
+// so that the remaining nodes of the same read request are served from the shadow store. the batch runs on the device
+// queue, with AsyncIO the read doesn't wait for it and is answered right away with BadWaitingForInitialData
+static std::optional<UA_StatusCode> read_robot_shadow_value(const UA_NodeId* nodeId, void* nodeContext,
+                                                            UA_Boolean sourceTimeStamp, UA_DataValue* dataValue) {
+    const auto robot = static_cast<Robot*>(nodeContext);
+    if (!robot) {
+        return {};
+    }
+    if (robot->shadow.read(nodeId->identifier.numeric, dataValue, sourceTimeStamp)) {
+        return UA_STATUSCODE_GOOD;
+    }
+    std::shared_lock<std::shared_mutex> nodes(robot->nodes_mutex);
+    const RobotNode* node = find_node(robot->indexed_nodes, *nodeId);
+    if (node == nullptr || !node->read_command.has_value()) {
+        return {};
+    }
+    if (!robot->r3.connected) {
+        return UA_STATUSCODE_BADDEVICEFAILURE;
+    }
+    // the queued read takes the lock itself, it runs right away if the queue was just detached
+    nodes.unlock();
+    if (robot->async_io) {
+        if (!robot->missing_read_queued.exchange(true)) {
+            robot->io.push([robot] {
+                robot->missing_read_queued = false;
+                std::shared_lock<std::shared_mutex> queued_nodes(robot->nodes_mutex);
+                read_missing_robot_values(robot);
+            });
+        }
+        return UA_STATUSCODE_BADWAITINGFORINITIALDATA;
+    }
+    // the read waits for the poll cycle that runs on the queue, so that it isn't sent in between its requests
+    const auto read = robot->io.call(
+        [robot] {
+            std::shared_lock<std::shared_mutex> queued_nodes(robot->nodes_mutex);
+            read_missing_robot_values(robot);
+            return true;
+        },
+        0);
+    if (!read.has_value() || !robot->shadow.read(nodeId->identifier.numeric, dataValue, sourceTimeStamp)) {
+        return UA_STATUSCODE_BADDEVICEFAILURE;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode read_robot_value(UA_Server* server, const UA_NodeId* sessionId, void* sessionContext,
+                                      const UA_NodeId* nodeId, void* nodeContext, UA_Boolean sourceTimeStamp,
+                                      const UA_NumericRange* range, UA_DataValue* dataValue) {
+    const auto result = read_robot_shadow_value(nodeId, nodeContext, sourceTimeStamp, dataValue);
+    if (result.has_value()) {
+        return result.value();
     }
+    double value = 0;
+    UA_Variant_setScalarCopy(&dataValue->value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
     dataValue->hasValue = true;
     return UA_STATUSCODE_GOOD;
 }
@@ -160,70 +579,35 @@ static UA_StatusCode read_robot_value(UA_Server* server, const UA_NodeId* sessio
 static UA_StatusCode read_robot_array_value(UA_Server* server, const UA_NodeId* sessionId, void* sessionContext,
                                             const UA_NodeId* nodeId, void* nodeContext, UA_Boolean sourceTimeStamp,
                                             const UA_NumericRange* range, UA_DataValue* dataValue) {
-    const auto robot = static_cast<Robot*>(nodeContext);
-    const RobotNode* node;
-    if (robot && (node = robot->node.get_node(nodeId->namespaceIndex, nodeId->identifier.numeric)) != nullptr &&
-        node->read_command.has_value()) {
-        if (!robot->r3.connected) {
-            return UA_STATUSCODE_BADDEVICEFAILURE;
-        }
-        if (node->datatype == "Position" || node->datatype == "Joint") {
-            const auto [read_command, match] = format_read_command(node->read_command.value());
-            if (node->datatype == "Position") {
-                std::array<double, 10> position{};
-                robot->r3.get_position(read_command, match, position.data(), position.size());
-                UA_Variant_setArrayCopy(&dataValue->value, position.data(), position.size(),
-                                        &UA_TYPES[UA_TYPES_DOUBLE]);
-            } else {
-                std::array<double, 8> position{};
-                robot->r3.get_position(read_command, match, position.data(), position.size());
-                UA_Variant_setArrayCopy(&dataValue->value, position.data(), position.size(),
-                                        &UA_TYPES[UA_TYPES_DOUBLE]);
-            }
-        } else {
-            if (node->datatype == "Double") {
-                // double array
-                std::vector<double> values(node->count);
-                for (std::size_t i = 0; i < node->count; i++) {
-                    const auto [read_command, match] = format_read_command(node->read_command.value(), i + 1);
-                    values[i] = robot->r3.get<double>(read_command, match);
-                }
-                UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_DOUBLE]);
-            } else if (node->datatype == "Int32") {
-                // int32 array
-                std::vector<int32_t> values(node->count);
-                for (std::size_t i = 0; i < node->count; i++) {
-                    const auto [read_command, match] = format_read_command(node->read_command.value(), i + 1);
-                    values[i] = robot->r3.get<int32_t>(read_command, match);
-                }
-                UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_INT32]);
-            } else if (node->datatype == "String") {
-                // string array
-                std::vector<UA_String> values{};
-                values.reserve(node->count);
-                for (std::size_t i = 0; i < node->count; i++) {
-                    const auto [read_command, match] = format_read_command(node->read_command.value(), i + 1);
-                    values.emplace_back(UA_STRING_ALLOC(robot->r3.get<std::string>(read_command, match).data()));
-                }
-                UA_Variant_setArrayCopy(&dataValue->value, values.data(), values.size(), &UA_TYPES[UA_TYPES_STRING]);
-            } else {
-                throw std::runtime_error{"Invalid data type"};
-            }
-        }
-    } else {
-        const double value = 0;
-        UA_Variant_setArrayCopy(&dataValue->value, &value, 1, &UA_TYPES[UA_TYPES_DOUBLE]);
+    const auto result = read_robot_shadow_value(nodeId, nodeContext, sourceTimeStamp, dataValue);
+    if (result.has_value()) {
+        return result.value();
     }
+    const double value = 0;
+    UA_Variant_setArrayCopy(&dataValue->value, &value, 1, &UA_TYPES[UA_TYPES_DOUBLE]);
     dataValue->hasValue = true;
     return UA_STATUSCODE_GOOD;
 }
 
+// read callback of a value node whose datatype isn't supported, the node is kept so that the address space matches
+// the template
+static UA_StatusCode read_unsupported_robot_value(UA_Server* server, const UA_NodeId* sessionId, void* sessionContext,
+                                                  const UA_NodeId* nodeId, void* nodeContext,
+                                                  UA_Boolean sourceTimeStamp, const UA_NumericRange* range,
+                                                  UA_DataValue* dataValue) {
+    return UA_STATUSCODE_BADNOTSUPPORTED;
+}
+
 static UA_StatusCode write_robot_value(UA_Server* server, const UA_NodeId* sessionId, void* sessionContext,
                                        const UA_NodeId* nodeId, void* nodeContext, const UA_NumericRange* range,
                                        const UA_DataValue* dataValue) {
     const auto robot = static_cast<Robot*>(nodeContext);
+    if (robot == nullptr) {
+        return UA_STATUSCODE_GOOD;
+    }
+    std::shared_lock<std::shared_mutex> nodes(robot->nodes_mutex);
     const RobotNode* node;
-    if (robot && (node = robot->node.get_node(nodeId->namespaceIndex, nodeId->identifier.numeric)) != nullptr &&
+    if ((node = find_node(robot->indexed_nodes, *nodeId)) != nullptr &&
         node->write_command.has_value()) {
         if (!robot->r3.connected || dataValue->value.arrayLength != 0) {
             return UA_STATUSCODE_BADDEVICEFAILURE;
@@ -238,42 +622,391 @@ static UA_StatusCode write_robot_value(UA_Server* server, const UA_NodeId* sessi
         } else {
             return UA_STATUSCODE_BADDEVICEFAILURE;
         }
-        return robot->r3.execute(command) ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDEVICEFAILURE;
+        nodes.unlock();
+
+        // the write runs on the device queue, a write that doesn't finish in time is still carried out after the
+        // callback returned, so the value is copied
+        const std::shared_ptr<UA_Variant> value(UA_Variant_new(), UA_Variant_delete);
+        if (UA_Variant_copy(&dataValue->value, value.get()) != UA_STATUSCODE_GOOD) {
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        const auto identifier = nodeId->identifier.numeric;
+        const auto answer = robot->io.call(
+            [robot, command, identifier, value] {
+                if (!robot->r3.execute(command)) {
+                    return false;
+                }
+                // reads return the written value until the next poll
+                robot->shadow.store_written(identifier, value.get());
+                return true;
+            },
+            robot->r3.request_timeout_ms);
+        if (!answer.has_value()) {
+            return UA_STATUSCODE_BADTIMEOUT;
+        }
+        return answer.value() ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDEVICEFAILURE;
     }
     return UA_STATUSCODE_GOOD;
 }
 
-inline void parse_robot_node(Robot* robot, UA_Server* server, RobotNode* parent, const nlohmann::basic_json<>& node,
-                             int mecha_no, int task_slot_no, uint16_t id = 0) {
+// optional max age in milliseconds of a cached answer of a command object of the specification or a user node
+inline std::chrono::milliseconds parse_max_age(const nlohmann::basic_json<>& command) {
+    return std::chrono::milliseconds{command.contains("MaxAge") ? command["MaxAge"].get<int64_t>() : 0};
+}
+
+inline std::optional<std::string> evaluate_structure_check(const RobotStructureCheck& check, RobotAnswers& answers,
+                                                           std::size_t index) {
+    if (check.condition) {
+        return check.match.matches(answers.answer(index).value_or("")) ? "1" : "0";
+    }
+    const auto value = answers.capture(index, check.match);
+    if (!value.has_value()) {
+        return {};
+    }
+    return std::string{value.value()};
+}
+
+// returns the index of the answer to command in the discovery answers of the robot, the command is only sent for the
+// first node that needs it
+inline std::size_t discover_answer(Robot* robot, const std::string& command, std::chrono::milliseconds max_age) {
+    const auto it = robot->discovery_commands.find(command);
+    if (it != robot->discovery_commands.end()) {
+        return it->second;
+    }
+    const auto index = robot->discovery_answers.add(robot->r3.get_cached_answer(command, max_age));
+    robot->discovery_commands.emplace(command, index);
+    return index;
+}
+
+// returns the value that match captures from the answer to command, and records it as structure check
+inline std::optional<std::string> discover_value(Robot* robot, const std::string& command, const R3::Matcher& match,
+                                                 std::chrono::milliseconds max_age) {
+    RobotStructureCheck check{command, match, false, {}};
+    check.result = evaluate_structure_check(check, robot->discovery_answers, discover_answer(robot, command, max_age));
+    robot->structure_checks.push_back(std::move(check));
+    return robot->structure_checks.back().result;
+}
+
+// returns whether match matches the answer to command, and records the result as structure check
+inline bool discover_condition(Robot* robot, const std::string& command, const R3::Matcher& match,
+                               std::chrono::milliseconds max_age) {
+    RobotStructureCheck check{command, match, true, {}};
+    check.result = evaluate_structure_check(check, robot->discovery_answers, discover_answer(robot, command, max_age));
+    robot->structure_checks.push_back(std::move(check));
+    return robot->structure_checks.back().result == "1";
+}
+
+// sends the commands of all structure checks as one batch and returns whether any check has a different result now
+inline bool robot_structure_changed(Robot* robot) {
+    std::vector<std::string> commands;
+    std::unordered_map<std::string, std::size_t> indices;
+    for (const auto& check : robot->structure_checks) {
+        if (indices.try_emplace(check.command, commands.size()).second) {
+            commands.push_back(check.command);
+        }
+    }
+    RobotAnswers answers{
+        robot->r3.get_cached_answers(commands, std::vector<std::chrono::milliseconds>(commands.size()))};
+    if (!robot->r3.connected) {
+        // the checks are repeated after the next reconnect
+        return false;
+    }
+    for (const auto& check : robot->structure_checks) {
+        if (evaluate_structure_check(check, answers, indices[check.command]) != check.result) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// directory in which the discovery answers of every controller are stored
+constexpr const char* robot_structure_directory = "robots";
+
+// identifies the controller of the robot by its serial number and firmware version, both commands are sent as one
+// batch and their answers are kept as discovery answers. returns nothing if the controller can't be identified
+inline std::optional<std::string> identify_robot(Robot* robot) {
+    const std::vector<std::string> commands{"1;1;RAREAD=", "1;1;OPEN=ROBOT"};
+    const auto answers = robot->r3.get_cached_answers(commands, {std::chrono::milliseconds{0}, {}});
+    for (std::size_t i = 0; i < commands.size(); i++) {
+        robot->discovery_commands.emplace(commands[i], robot->discovery_answers.add(answers[i]));
+    }
+    if (!answers[0].has_value() || !answers[1].has_value()) {
+        return {};
+    }
+    const auto serial_number = R3::split_fields(answers[0].value());
+    const auto controller = R3::split_fields(answers[1].value());
+    if (serial_number.size() < 2 || controller.size() < 11 || serial_number[1].empty()) {
+        return {};
+    }
+    auto identity = fmt::format("{}-{}", serial_number[1], controller[10]);
+    // the identity is used as file name
+    RE2::GlobalReplace(&identity, "[^A-Za-z0-9._-]", "_");
+    return identity;
+}
+
+// adds the stored discovery answers of the controller to the discovery answers of the robot, returns false if no
+// answers are stored
+inline bool load_robot_structure(Robot* robot, const std::filesystem::path& file) {
+    std::ifstream stream(file);
+    if (!stream) {
+        return false;
+    }
+    const auto data = nlohmann::json::parse(stream, nullptr, false, true);
+    if (data.is_discarded() || !data.contains("Answers") || !data["Answers"].is_object()) {
+        return false;
+    }
+    for (const auto& [command, answer] : data["Answers"].items()) {
+        if (robot->discovery_commands.find(command) == robot->discovery_commands.end()) {
+            robot->discovery_commands.emplace(
+                command, robot->discovery_answers.add(answer.is_string() ? std::make_optional(answer.get<std::string>())
+                                                                           : std::nullopt));
+        }
+    }
+    return true;
+}
+
+inline void save_robot_structure(const Robot* robot, const std::filesystem::path& file) {
+    nlohmann::json answers = nlohmann::json::object();
+    for (const auto& [command, index] : robot->discovery_commands) {
+        const auto& answer = robot->discovery_answers.answer(index);
+        answers[command] = answer.has_value() ? nlohmann::json(answer.value()) : nlohmann::json(nullptr);
+    }
+    std::error_code error;
+    std::filesystem::create_directories(file.parent_path(), error);
+    std::ofstream stream(file);
+    if (error || !stream) {
+        UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Couldn't store the structure of robot %s in %s",
+                       robot->name.c_str(), file.string().c_str());
+        return;
+    }
+    stream << nlohmann::json{{"Answers", answers}}.dump(4, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+inline RobotNodeTemplate compile_robot_node(const nlohmann::basic_json<>& node) {
+    const auto compile_command = [](const nlohmann::basic_json<>& command) {
+        return RobotNodeTemplate::Command{command["Command"].get<std::string>(), command["Match"].get<std::string>(),
+                                          parse_max_age(command)};
+    };
+    const auto compile_cases = [](const nlohmann::basic_json<>& cases) {
+        std::vector<std::tuple<std::string, std::string, int64_t>> compiled;
+        for (const auto& it : cases.items()) {
+            compiled.emplace_back(it.key(), it.value()["EnumString"].get<std::string>(),
+                                  it.value()["Value"].get<int64_t>());
+        }
+        return compiled;
+    };
+
+    RobotNodeTemplate compiled;
     const auto type = node["Type"].get<std::string>();
-    auto name = format_name(node["Name"].get<std::string>(), id);
+    compiled.name = node["Name"].get<std::string>();
     if (type == "Folder") {
+        compiled.type = RobotNodeTemplate::Type::Folder;
+        compiled.folder = !node.contains("DisplayType") || node["DisplayType"].get<std::string>() != "Object";
+        if (node["Count"].is_object()) {
+            compiled.count_command = compile_command(node["Count"]);
+            const auto datatype = node["Count"]["Datatype"].get<std::string>();
+            if (datatype == "BitCount") {
+                compiled.count_datatype = RobotNodeTemplate::CountDatatype::BitCount;
+            } else if (datatype == "HexUInt") {
+                compiled.count_datatype = RobotNodeTemplate::CountDatatype::HexUInt;
+            }
+        } else {
+            compiled.count = node["Count"].get<uint16_t>();
+        }
+        compiled.children.push_back(compile_robot_node(node["FolderChild"]));
+    } else if (type == "Object") {
+        compiled.type = RobotNodeTemplate::Type::Object;
+        if (node.contains("Condition")) {
+            compiled.condition = compile_command(node["Condition"]);
+        }
+        for (const auto& child_node : node["Children"]) {
+            compiled.children.push_back(compile_robot_node(child_node));
+        }
+    } else if (type == "Property") {
+        compiled.type = RobotNodeTemplate::Type::Property;
+        if (node.contains("Value")) {
+            compiled.value = node["Value"].get<std::string>();
+        }
+        if (node.contains("ReadCommand")) {
+            compiled.read_command = compile_command(node["ReadCommand"]);
+        }
+    } else if (type == "EnumProperty") {
+        compiled.type = RobotNodeTemplate::Type::EnumProperty;
+        compiled.read_command = compile_command(node["ReadCommand"]);
+        compiled.cases = compile_cases(node["Cases"]);
+        compiled.default_case = {node["Cases"]["Default"]["EnumString"].get<std::string>(),
+                                 node["Cases"]["Default"]["Value"].get<int64_t>()};
+    } else {
+        compiled.type = RobotNodeTemplate::Type::Value;
+        compiled.count = node.contains("Count") ? node["Count"].get<uint32_t>() : 0;
+        if (node.contains("Writeable") && node["Writeable"].get<bool>() && compiled.count == 0) {
+            // only non array types are writeable for now
+            compiled.write_command = node["WriteCommand"]["Command"].get<std::string>();
+        }
+        compiled.read_command = compile_command(node["ReadCommand"]);
+        compiled.datatype = node["Datatype"].get<std::string>();
+        compiled.decode = robot_decoder(compiled.datatype, compiled.count);
+        if (compiled.decode == nullptr) {
+            UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Datatype '%s' of node '%s' is not supported",
+                           compiled.datatype.c_str(), compiled.name.c_str());
+        }
+        if (node.contains("Cases")) {
+            compiled.cases = compile_cases(node["Cases"]);
+            compiled.case_set.emplace(compiled.cases);
+        }
+    }
+    return compiled;
+}
+
+inline std::vector<RobotNodeTemplate> compile_robot_specification(const nlohmann::basic_json<>& specification) {
+    std::vector<RobotNodeTemplate> nodes;
+    for (const auto& node : specification["Nodes"]) {
+        nodes.push_back(compile_robot_node(node));
+    }
+    return nodes;
+}
+
+// command that the structure of a node of the specification depends on
+struct RobotDiscoveryQuery {
+    std::string command;
+    R3::Matcher match;
+    std::chrono::milliseconds max_age;
+};
+
+// returns the query of node, nothing if the node is created without an answer of the robot
+inline std::optional<RobotDiscoveryQuery> robot_discovery_query(const RobotNodeTemplate& node,
+                                                                const std::string& parent_name, int mecha_no,
+                                                                int task_slot_no, uint16_t id) {
+    const auto query = [&](const RobotNodeTemplate::Command& command, const R3::Command& read_command) {
+        auto [formatted_command, match] = format_read_command(read_command);
+        return std::make_optional<RobotDiscoveryQuery>({std::move(formatted_command), std::move(match),
+                                                        command.max_age});
+    };
+    const auto name = format_name(node.name, id);
+    if (node.type == RobotNodeTemplate::Type::Folder && node.count_command.has_value() &&
+        (name != "AdditionalComponents" || mecha_no == 1)) {
+        return query(node.count_command.value(),
+                     {node.count_command->command, node.count_command->match, mecha_no, task_slot_no});
+    }
+    if (node.type == RobotNodeTemplate::Type::Object && node.condition.has_value()) {
+        return query(node.condition.value(),
+                     {node.condition->command, node.condition->match, mecha_no, task_slot_no, id});
+    }
+    if ((node.type == RobotNodeTemplate::Type::Property && !node.value.has_value() &&
+         !(name == "Model" && RE2::PartialMatch(parent_name, "MotionDevice_") && parent_name != "MotionDevice_1")) ||
+        node.type == RobotNodeTemplate::Type::EnumProperty) {
+        return query(node.read_command.value(),
+                     {node.read_command->command, node.read_command->match, mecha_no, task_slot_no, id});
+    }
+    return {};
+}
+
+// returns the number of children of a folder node with the count captured from the answer to its count command
+inline uint16_t robot_folder_count(const RobotNodeTemplate& node, const std::optional<std::string>& value) {
+    if (!node.count_command.has_value()) {
+        return static_cast<uint16_t>(node.count);
+    }
+    if (node.count_datatype == RobotNodeTemplate::CountDatatype::BitCount) {
+        return __builtin_popcount(R3::convert_hex<uint16_t>(value));
+    }
+    if (node.count_datatype == RobotNodeTemplate::CountDatatype::HexUInt) {
+        return R3::convert_hex<uint16_t>(value);
+    }
+    return R3::convert<uint16_t>(value);
+}
+
+// sends the discovery queries of the specification one level of the node tree at a time, each level as one pipelined
+// batch of distinct commands, so that creating the nodes afterwards finds every answer in the discovery answers and
+// the discovery takes one round trip per level instead of one per query
+inline void prefetch_robot_discovery(Robot* robot, const std::vector<RobotNodeTemplate>& specification) {
+    struct PendingNode {
+        const RobotNodeTemplate* node;
+        std::string parent_name;
+        int mecha_no;
+        int task_slot_no;
+        uint16_t id;
+        std::optional<RobotDiscoveryQuery> query;
+    };
+    std::vector<PendingNode> level;
+    for (const auto& node : specification) {
+        level.push_back({&node, robot->node.name, 1, 1, 0, {}});
+    }
+    while (!level.empty() && robot->r3.connected) {
+        std::vector<std::string> commands;
+        std::vector<std::chrono::milliseconds> max_ages;
+        // views of the queries of this level, which stay in place until the level is done
+        std::unordered_set<std::string_view> queued_commands;
+        for (auto& pending : level) {
+            pending.query =
+                robot_discovery_query(*pending.node, pending.parent_name, pending.mecha_no, pending.task_slot_no,
+                                      pending.id);
+            if (pending.query.has_value() &&
+                robot->discovery_commands.find(pending.query->command) == robot->discovery_commands.end() &&
+                queued_commands.insert(pending.query->command).second) {
+                commands.push_back(pending.query->command);
+                max_ages.push_back(pending.query->max_age);
+            }
+        }
+        const auto answers = robot->r3.get_cached_answers(commands, max_ages);
+        for (std::size_t i = 0; i < commands.size(); i++) {
+            robot->discovery_commands.emplace(commands[i], robot->discovery_answers.add(answers[i]));
+        }
+
+        std::vector<PendingNode> next_level;
+        for (const auto& pending : level) {
+            const auto& node = *pending.node;
+            const auto name = format_name(node.name, pending.id);
+            std::optional<std::string> result;
+            if (pending.query.has_value()) {
+                RobotStructureCheck check{pending.query->command, pending.query->match,
+                                          node.type == RobotNodeTemplate::Type::Object, {}};
+                result = evaluate_structure_check(check, robot->discovery_answers,
+                                                  robot->discovery_commands[pending.query->command]);
+            }
+            if (node.type == RobotNodeTemplate::Type::Folder) {
+                if (name == "AdditionalComponents" && pending.mecha_no != 1) {
+                    continue;
+                }
+                auto mecha_no = pending.mecha_no;
+                auto task_slot_no = pending.task_slot_no;
+                const auto count = robot_folder_count(node, result);
+                for (uint16_t i = 0; i < count; i++) {
+                    next_level.push_back({&node.children.front(), name, mecha_no, task_slot_no,
+                                          static_cast<uint16_t>(i + 1), {}});
+                    if (name == "MotionDevices") {
+                        mecha_no++;
+                    } else if (name == "TaskControls") {
+                        task_slot_no++;
+                    }
+                }
+            } else if (node.type == RobotNodeTemplate::Type::Object && (!pending.query.has_value() || result == "1")) {
+                for (const auto& child_node : node.children) {
+                    next_level.push_back(
+                        {&child_node, name, pending.mecha_no, pending.task_slot_no, pending.id, {}});
+                }
+            }
+        }
+        level = std::move(next_level);
+    }
+}
+
+inline void parse_robot_node(Robot* robot, UA_Server* server, RobotNode* parent, const RobotNodeTemplate& node,
+                             int mecha_no, int task_slot_no, uint16_t id = 0) {
+    auto name = format_name(node.name, id);
+    if (node.type == RobotNodeTemplate::Type::Folder) {
         if (name == "AdditionalComponents" && mecha_no != 1) {
             // only show AdditionalComponents on first mecha
             return;
         }
 
-        parent->children.emplace_back(
-            addObjectNode(server, name.data(), parent->node,
-                          !node.contains("DisplayType") || node["DisplayType"].get<std::string>() != "Object"));
+        parent->children.emplace_back(addObjectNode(server, name.data(), parent->node, node.folder));
         parent->children.back().name = name;
-        uint16_t count = 0;
-        if (node["Count"].is_object()) {
-            const auto [read_command, match] =
-                format_read_command({node["Count"]["Command"].get<std::string>(),
-                                     node["Count"]["Match"].get<std::string>(), mecha_no, task_slot_no});
-            if (node["Count"]["Datatype"].get<std::string>() == "BitCount") {
-                count = __builtin_popcount(robot->r3.get_hex<uint16_t>(read_command, match));
-            } else if (node["Count"]["Datatype"].get<std::string>() == "HexUInt") {
-                count = robot->r3.get_hex<uint16_t>(read_command, match);
-            } else {
-                count = robot->r3.get<uint16_t>(read_command, match);
-            }
-        } else {
-            count = node["Count"].get<uint16_t>();
-        }
+        const auto query = robot_discovery_query(node, parent->name, mecha_no, task_slot_no, id);
+        const auto count = robot_folder_count(
+            node, query.has_value() ? discover_value(robot, query->command, query->match, query->max_age)
+                                    : std::optional<std::string>{});
         for (uint16_t i = 0; i < count; i++) {
-            parse_robot_node(robot, server, &parent->children.back(), node["FolderChild"], mecha_no, task_slot_no,
+            parse_robot_node(robot, server, &parent->children.back(), node.children.front(), mecha_no, task_slot_no,
                              i + 1);
             if (name == "MotionDevices") {
                 mecha_no++;
@@ -281,48 +1014,40 @@ inline void parse_robot_node(Robot* robot, UA_Server* server, RobotNode* parent,
                 task_slot_no++;
             }
         }
-    } else if (type == "Object") {
-        if (node.contains("Condition")) {
-            const auto [read_command, match] =
-                format_read_command({node["Condition"]["Command"].get<std::string>(),
-                                     node["Condition"]["Match"].get<std::string>(), mecha_no, task_slot_no, id});
-            if (!RE2::PartialMatch(robot->r3.get(read_command), match)) {
-                return;
-            }
+    } else if (node.type == RobotNodeTemplate::Type::Object) {
+        const auto query = robot_discovery_query(node, parent->name, mecha_no, task_slot_no, id);
+        if (query.has_value() && !discover_condition(robot, query->command, query->match, query->max_age)) {
+            return;
         }
         parent->children.emplace_back(addObjectNode(server, name.data(), parent->node, false));
         parent->children.back().name = name;
-        for (const auto& child_node : node["Children"]) {
+        for (const auto& child_node : node.children) {
             parse_robot_node(robot, server, &parent->children.back(), child_node, mecha_no, task_slot_no, id);
         }
-    } else if (type == "Property") {
+    } else if (node.type == RobotNodeTemplate::Type::Property) {
         std::string value;  // always of type string
-        if (node.contains("Value")) {
-            value = fmt::format(fmt::runtime(node["Value"].get<std::string>()), fmt::arg("i", id));
+        if (node.value.has_value()) {
+            value = fmt::format(fmt::runtime(node.value.value()), fmt::arg("i", id));
         } else if (name == "Model" && RE2::PartialMatch(parent->name, "MotionDevice_") &&
                    parent->name != "MotionDevice_1") {
             // all mechas except mecha 1 have name "USER"
             value = "USER";
         } else {
-            const auto [read_command, match] =
-                format_read_command({node["ReadCommand"]["Command"].get<std::string>(),
-                                     node["ReadCommand"]["Match"].get<std::string>(), mecha_no, task_slot_no, id});
-            value = robot->r3.get<std::string>(read_command, match);
+            const auto query = robot_discovery_query(node, parent->name, mecha_no, task_slot_no, id);
+            value = R3::convert<std::string>(discover_value(robot, query->command, query->match, query->max_age));
         }
         // TODO: differentiate between UA_TYPES_STRING and UA_TYPES_LOCALIZEDTEXT
         auto value_type_obj = Datatype<UA_String>(value.data());
         parent->children.emplace_back(
             addVariableNode<UA_String>(server, robot, name.data(), {parent->node}, {value_type_obj}, {}, {}, 0u));
         parent->children.back().name = name;
-    } else if (type == "EnumProperty") {
-        const auto [read_command, match] =
-            format_read_command({node["ReadCommand"]["Command"].get<std::string>(),
-                                 node["ReadCommand"]["Match"].get<std::string>(), mecha_no, task_slot_no, id});
-        auto answer = robot->r3.get<std::string>(read_command, match);
+    } else if (node.type == RobotNodeTemplate::Type::EnumProperty) {
+        const auto query = robot_discovery_query(node, parent->name, mecha_no, task_slot_no, id);
+        auto answer = R3::convert<std::string>(discover_value(robot, query->command, query->match, query->max_age));
         std::string enum_string;
         int64_t enum_value = -1;
-        for (const auto& it : node["Cases"].items()) {
-            if (RE2::PartialMatch(answer, it.key())) {
+        for (const auto& [pattern, case_string, case_value] : node.cases) {
+            if (RE2::PartialMatch(answer, pattern)) {
                 if (name == "MotionProfile" && mecha_no == 1 && id == 3 && RE2::PartialMatch(answer, "^[rR][hH]")) {
                     // special case for j3 axis on rh robots
                     enum_string = "LINEAR";
@@ -335,60 +1060,52 @@ inline void parse_robot_node(Robot* robot, UA_Server* server, RobotNode* parent,
                     enum_value = 0;
                     break;
                 }
-                enum_string = it.value()["EnumString"].get<std::string>();
-                enum_value = it.value()["Value"].get<int64_t>();
+                enum_string = case_string;
+                enum_value = case_value;
                 break;
             }
         }
         if (enum_value == -1) {
-            enum_string = node["Cases"]["Default"]["EnumString"].get<std::string>();
-            enum_value = node["Cases"]["Default"]["Value"].get<int64_t>();
+            std::tie(enum_string, enum_value) = node.default_case;
         }
         auto value_type_obj = Datatype<UA_EnumValueType>(enum_value, enum_string);
         parent->children.emplace_back(
             addVariableNode<UA_EnumValueType>(server, robot, name.data(), {parent->node}, {value_type_obj}, {}, {}, 0));
         parent->children.back().name = name;
+    } else if (node.decode == nullptr) {
+        // value with an unsupported datatype, already warned about when the template was compiled
+        parent->children.emplace_back(addVariableNode<UA_String>(server, robot, name.data(), {parent->node}, {},
+                                                                 read_unsupported_robot_value, {}, node.count));
+        parent->children.back().name = name;
     } else {
-        uint32_t count = node.contains("Count") ? node["Count"].get<uint32_t>() : 0;
-
         // value or enum value
-        if (node.contains("Writeable") && node["Writeable"].get<bool>() && count == 0) {
-            // read- and writeable (only for non array types for now)
+        if (node.write_command.has_value()) {
+            // read- and writeable
             parent->children.emplace_back(addVariableNode<UA_String>(server, robot, name.data(), {parent->node}, {},
-                                                                     read_robot_value, write_robot_value, count));
+                                                                     read_robot_value, write_robot_value, node.count));
 
             // save write command
-            auto write_command = node["WriteCommand"]["Command"].get<std::string>();
-            parent->children.back().write_command = std::make_optional<R3::Command>(write_command);
+            parent->children.back().write_command = std::make_optional<R3::Command>(node.write_command.value());
             parent->children.back().write_command->mecha_no = mecha_no;
             parent->children.back().write_command->id = id;
+            render_write_command(parent->children.back().write_command.value());
         } else {
             // only readable
-            parent->children.emplace_back(
-                addVariableNode<UA_String>(server, robot, name.data(), {parent->node}, {},
-                                           (count == 0) ? read_robot_value : read_robot_array_value, {}, count));
-        }
-
-        // save read command
-        auto read_command = node["ReadCommand"]["Command"].get<std::string>();
-        auto match = node["ReadCommand"]["Match"].get<std::string>();
-        auto datatype = node["Datatype"].get<std::string>();
-        parent->children.back().read_command = std::make_optional<R3::Command>(read_command, match);
-        parent->children.back().read_command->mecha_no = mecha_no;
-        parent->children.back().read_command->task_slot_no = task_slot_no;
-        parent->children.back().read_command->id = id;
-        parent->children.back().datatype = datatype;
-        parent->children.back().count = count;
-        parent->children.back().name = name;
-
-        // save enum values
-        if (node.contains("Cases")) {
-            // enum value
-            for (const auto& it : node["Cases"].items()) {
-                parent->children.back().read_command->cases.emplace_back(
-                    it.key(), it.value()["EnumString"].get<std::string>(), it.value()["Value"].get<int64_t>());
-            }
+            parent->children.emplace_back(addVariableNode<UA_String>(
+                server, robot, name.data(), {parent->node}, {},
+                (node.count == 0) ? read_robot_value : read_robot_array_value, {}, node.count));
         }
+
+        // save read command, enum values and the compiled enum cases are shared with the template
+        parent->children.back().read_command = std::make_optional<R3::Command>(
+            node.read_command->command, node.read_command->match, mecha_no, task_slot_no, id);
+        parent->children.back().read_command->max_age = node.read_command->max_age;
+        parent->children.back().read_command->cases = node.cases;
+        parent->children.back().read_command->case_set = node.case_set;
+        parent->children.back().decode = node.decode;
+        parent->children.back().count = node.count;
+        parent->children.back().name = name;
+        render_read_command(parent->children.back().read_command.value(), node.datatype, node.count);
     }
 }
 
@@ -396,6 +1113,17 @@ inline void parse_robot_user_node(Robot* robot, UA_Server* server, RobotNode* ba
                                   const nlohmann::basic_json<>& node) {
     std::string name = node["Name"].get<std::string>().data();
     std::string parent = node["Parent"].get<std::string>().data();
+    const auto datatype = node["Datatype"].get<std::string>();
+    const uint32_t count =
+        (datatype == "Position")
+            ? 10
+            : ((datatype == "Joint") ? 8 : (node.contains("Count") ? node["Count"].get<uint32_t>() : 0));
+    const auto decode = robot_decoder(datatype, count);
+    if (decode == nullptr) {
+        UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Datatype '%s' of node '%s' is not supported",
+                       datatype.c_str(), name.c_str());
+        return;
+    }
 
     // parent names are split with '/'
     // also non-existent parents are created as object nodes
@@ -415,12 +1143,6 @@ inline void parse_robot_user_node(Robot* robot, UA_Server* server, RobotNode* ba
         parent_node = new_parent_node;
     }
 
-    const auto datatype = node["Datatype"].get<std::string>();
-    const uint32_t count =
-        (datatype == "Position")
-            ? 10
-            : ((datatype == "Joint") ? 8 : (node.contains("Count") ? node["Count"].get<uint32_t>() : 0));
-
     if (node.contains("Writeable") && node["Writeable"].get<bool>() && count == 0) {
         // read- and writeable (only for non array types for now)
         parent_node->children.emplace_back(addVariableNode<UA_String>(server, robot, name.data(), {parent_node->node},
@@ -437,6 +1159,7 @@ inline void parse_robot_user_node(Robot* robot, UA_Server* server, RobotNode* ba
         parent_node->children.back().write_command = std::make_optional<R3::Command>(write_command);
         parent_node->children.back().write_command->mecha_no = mecha_no;
         parent_node->children.back().write_command->task_slot_no = task_slot_no;
+        render_write_command(parent_node->children.back().write_command.value());
     } else {
         // only readable
         parent_node->children.emplace_back(
@@ -455,22 +1178,48 @@ inline void parse_robot_user_node(Robot* robot, UA_Server* server, RobotNode* ba
     parent_node->children.back().read_command = std::make_optional<R3::Command>(read_command, match);
     parent_node->children.back().read_command->mecha_no = mecha_no;
     parent_node->children.back().read_command->task_slot_no = task_slot_no;
-    parent_node->children.back().datatype = datatype;
+    parent_node->children.back().read_command->max_age = parse_max_age(node["ReadCommand"]);
+    render_read_command(parent_node->children.back().read_command.value(), datatype, count);
+    parent_node->children.back().decode = decode;
     parent_node->children.back().count = count;
 }
 
 inline void create_robot_node(Robot* robot, UA_Server* server, const char* client_file_name) {
     UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Creating robot node %s", robot->name.c_str());
 
-    std::ifstream specs("specifications/robot-specification.json");
-    nlohmann::json data = nlohmann::json::parse(specs, nullptr, true, true);
+    const auto specification =
+        load_specification("specifications/robot-specification.json", compile_robot_specification);
 
     robot->node.node = addObjectNode(server, robot->name.data(), {}, false);
 
-    for (const auto& node : data["Nodes"]) {
+    robot->discovery_answers.clear();
+    robot->discovery_commands.clear();
+    robot->structure_checks.clear();
+    std::optional<std::filesystem::path> structure_file;
+    if (robot->cache_structure) {
+        const auto identity = identify_robot(robot);
+        if (identity.has_value()) {
+            structure_file = std::filesystem::path(robot_structure_directory) / (identity.value() + ".json");
+            if (load_robot_structure(robot, structure_file.value())) {
+                UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Loaded structure of robot %s from %s",
+                            robot->name.c_str(), structure_file->string().c_str());
+            }
+        }
+    }
+    const auto known_commands = robot->discovery_commands.size();
+
+    prefetch_robot_discovery(robot, *specification);
+    for (const auto& node : *specification) {
         parse_robot_node(robot, server, &robot->node, node, 1, 1);
     }
 
+    // only store complete discoveries, an answer missing because of a lost connection would change the structure
+    if (structure_file.has_value() && robot->discovery_commands.size() != known_commands && robot->r3.connected) {
+        save_robot_structure(robot, structure_file.value());
+    }
+    robot->discovery_answers.clear();
+    robot->discovery_commands.clear();
+
     std::ifstream client_file(client_file_name);
     nlohmann::json clients_data = nlohmann::json::parse(client_file, nullptr, true, true);
 
@@ -481,5 +1230,45 @@ inline void create_robot_node(Robot* robot, UA_Server* server, const char* clien
             }
         }
     }
+
+    {
+        std::unique_lock<std::shared_mutex> nodes(robot->nodes_mutex);
+        robot->polled_nodes.clear();
+        collect_polled_nodes(robot->node, robot->polled_nodes);
+        robot->indexed_nodes.clear();
+        index_nodes(robot->node, robot->indexed_nodes);
+    }
+    robot->poll_plan = plan_robot_reads(robot->polled_nodes);
     UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Created robot node %s", robot->name.c_str());
+}
+
+inline void delete_robot_node(Robot* robot, UA_Server* server) {
+    if (UA_NodeId_isNull(&robot->node.node)) {
+        return;
+    }
+    {
+        // waits for the callbacks that still use the nodes, later callbacks don't find them anymore. the server nodes
+        // are deleted without holding the lock, a callback may hold the lock of the server while it waits for it
+        std::unique_lock<std::shared_mutex> nodes(robot->nodes_mutex);
+        robot->polled_nodes.clear();
+        robot->indexed_nodes.clear();
+    }
+    delete_node(server, robot->node.node, true);
+    robot->poll_plan = {};
+    robot->node = RobotNode{UA_NODEID_NULL};
+    robot->shadow.clear();
+}
+
+// creates the nodes of the robot on its first connect. after a reconnect the nodes are kept, so that opc ua clients
+// keep their subscriptions, unless the structure of the robot changed
+inline void update_robot_node(Robot* robot, UA_Server* server, const char* client_file_name) {
+    if (!UA_NodeId_isNull(&robot->node.node)) {
+        if (!robot_structure_changed(robot)) {
+            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Kept robot node %s", robot->name.c_str());
+            return;
+        }
+        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Structure of robot %s changed", robot->name.c_str());
+        delete_robot_node(robot, server);
+    }
+    create_robot_node(robot, server, client_file_name);
 }
\ No newline at end of file
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <open62541/types.h>
+#include <open62541/types_generated.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// latest known value of a device node, refreshed by the device poller
+struct ShadowValue {
+    UA_Variant value;
+    UA_StatusCode status;
+    UA_DateTime source_timestamp;
+    // copy of value lent to the opc ua server by reads, only reads touch it so that the poller can't change it while
+    // the server encodes a response
+    UA_Variant published;
+};
+
+// bump allocator for the values decoded by a device poller. the values are built in the arena, copied into the
+// shadow store and dropped again with reset, so that once the arena has grown to the values of a poll cycle decoding
+// doesn't allocate anymore
+class ScratchArena {
+   public:
+    ScratchArena() = default;
+    ScratchArena(ScratchArena const&) = delete;
+    ScratchArena& operator=(ScratchArena const&) = delete;
+    ScratchArena(ScratchArena&&) = default;
+    ScratchArena& operator=(ScratchArena&&) = default;
+
+    // count value initialized elements, valid until the next reset. the arena never runs destructors
+    template <typename Type>
+    Type* allocate(std::size_t count) {
+        static_assert(std::is_trivially_destructible_v<Type>, "the arena never runs destructors");
+        static_assert(alignof(Type) <= alignof(std::max_align_t), "blocks are only aligned to max_align_t");
+        const auto size = std::max<std::size_t>(count, 1) * sizeof(Type);
+        auto offset = (used + alignof(Type) - 1) / alignof(Type) * alignof(Type);
+        if (blocks.empty() || offset + size > block_size) {
+            // full blocks are kept until reset, as the values built in them are still in use
+            block_size = std::max(size, block_size * 2);
+            blocks.push_back(std::make_unique<std::byte[]>(block_size));
+            reserved += block_size;
+            offset = 0;
+        }
+        used = offset + size;
+        const auto data = reinterpret_cast<Type*>(blocks.back().get() + offset);
+        std::uninitialized_value_construct_n(data, count);
+        return data;
+    }
+
+    // drops all values, blocks that were added since the last reset are merged into one block large enough for all
+    // of them
+    void reset() {
+        if (blocks.size() > 1) {
+            blocks.clear();
+            block_size = reserved;
+            blocks.push_back(std::make_unique<std::byte[]>(block_size));
+        }
+        used = 0;
+    }
+
+   private:
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::size_t block_size = 0;
+    std::size_t used = 0;
+    std::size_t reserved = 0;
+};
+
+// point value at data built in a ScratchArena, value only borrows data and is never cleared
+inline void borrow_scalar(UA_Variant* value, void* data, const UA_DataType* type) {
+    UA_Variant_setScalar(value, data, type);
+    value->storageType = UA_VARIANT_DATA_NODELETE;
+}
+
+inline void borrow_array(UA_Variant* value, void* data, std::size_t size, const UA_DataType* type) {
+    UA_Variant_setArray(value, data, size, type);
+    value->storageType = UA_VARIANT_DATA_NODELETE;
+}
+
+// copies source into the buffers of target if target already holds a value of the same type and size, e.g. the
+// previous value of the same node. returns false if new buffers are needed
+inline bool copy_variant_in_place(UA_Variant* target, const UA_Variant* source) {
+    if (target->type != source->type || target->data <= UA_EMPTY_ARRAY_SENTINEL ||
+        source->data <= UA_EMPTY_ARRAY_SENTINEL ||
+        target->storageType != UA_VARIANT_DATA || target->arrayLength != source->arrayLength ||
+        target->arrayDimensionsSize != 0 || source->arrayDimensionsSize != 0) {
+        return false;
+    }
+    const auto count = std::max<std::size_t>(source->arrayLength, 1);
+    if (source->type->pointerFree) {
+        std::memcpy(target->data, source->data, count * source->type->memSize);
+        return true;
+    }
+    if (source->type != &UA_TYPES[UA_TYPES_STRING]) {
+        return false;
+    }
+    const auto target_strings = static_cast<UA_String*>(target->data);
+    const auto source_strings = static_cast<const UA_String*>(source->data);
+    for (std::size_t i = 0; i < count; i++) {
+        if (target_strings[i].length != source_strings[i].length) {
+            return false;
+        }
+    }
+    for (std::size_t i = 0; i < count; i++) {
+        if (source_strings[i].length > 0) {
+            std::memcpy(target_strings[i].data, source_strings[i].data, source_strings[i].length);
+        }
+    }
+    return true;
+}
+
+// per device store of the latest node values, so that opc ua reads never have to wait on the device
+class ShadowStore {
+   public:
+    ShadowStore() = default;
+    ShadowStore(ShadowStore const&) = delete;
+    ShadowStore& operator=(ShadowStore const&) = delete;
+
+    ~ShadowStore() {
+        clear();
+    }
+
+    // lends the latest value of the node to data_value, returns false if no value is stored yet. the value is copied
+    // into the published buffers of the node, which only allocates on the first read of a node, and data_value only
+    // borrows them, the opc ua server never frees borrowed data and is done with it once the response is encoded. a
+    // value whose size changed, e.g. a longer string, is copied into data_value instead, as a response of the same
+    // request may still borrow the published buffers
+    bool read(UA_UInt32 identifier, UA_DataValue* data_value, UA_Boolean source_timestamp) {
+        std::scoped_lock<std::mutex> guard(mutex);
+        const auto it = values.find(identifier);
+        if (it == values.end()) {
+            return false;
+        }
+        auto& entry = it->second;
+        if (entry.published.type == nullptr && UA_Variant_copy(&entry.value, &entry.published) != UA_STATUSCODE_GOOD) {
+            UA_Variant_init(&entry.published);
+            return false;
+        }
+        if (copy_variant_in_place(&entry.published, &entry.value)) {
+            data_value->value = entry.published;
+            data_value->value.storageType = UA_VARIANT_DATA_NODELETE;
+        } else if (UA_Variant_copy(&entry.value, &data_value->value) != UA_STATUSCODE_GOOD) {
+            return false;
+        }
+        data_value->hasValue = true;
+        if (entry.status != UA_STATUSCODE_GOOD) {
+            data_value->hasStatus = true;
+            data_value->status = entry.status;
+        }
+        if (source_timestamp) {
+            data_value->hasSourceTimestamp = true;
+            data_value->sourceTimestamp = entry.source_timestamp;
+        }
+        return true;
+    }
+
+    // copies value, which stays owned by the caller, e.g. a value built in a ScratchArena. the buffers of the stored
+    // value are reused if the new value has the same type and size, so that storing a changed scalar doesn't allocate.
+    // a value that couldn't be read because the device was lost doesn't replace a stored value, the stored value is
+    // kept as last usable value instead
+    void store(UA_UInt32 identifier, const UA_Variant* value, UA_StatusCode status) {
+        const auto now = UA_DateTime_now();
+        std::scoped_lock<std::mutex> guard(mutex);
+        if (status != UA_STATUSCODE_GOOD) {
+            const auto it = values.find(identifier);
+            if (it != values.end()) {
+                it->second.status = UA_STATUSCODE_UNCERTAINLASTUSABLEVALUE;
+                return;
+            }
+        }
+        auto& entry = values[identifier];
+        if (!copy_variant_in_place(&entry.value, value)) {
+            UA_Variant_clear(&entry.value);
+            UA_Variant_copy(value, &entry.value);
+        }
+        entry.status = status;
+        entry.source_timestamp = now;
+    }
+
+    bool contains(UA_UInt32 identifier) const {
+        std::scoped_lock<std::mutex> guard(mutex);
+        return values.find(identifier) != values.end();
+    }
+
+    // stores value, which the device accepted with a write, until the next poll reads the value of the device. a
+    // value of another type than the stored value, e.g. a command argument of a robot, only keeps the stored value as
+    // last usable value. a node without a stored value is read from the device with the next read
+    void store_written(UA_UInt32 identifier, const UA_Variant* value) {
+        const auto now = UA_DateTime_now();
+        std::scoped_lock<std::mutex> guard(mutex);
+        const auto it = values.find(identifier);
+        if (it == values.end()) {
+            return;
+        }
+        auto& entry = it->second;
+        if (entry.value.type != value->type || entry.value.arrayLength != value->arrayLength) {
+            entry.status = UA_STATUSCODE_UNCERTAINLASTUSABLEVALUE;
+            return;
+        }
+        if (!copy_variant_in_place(&entry.value, value)) {
+            UA_Variant_clear(&entry.value);
+            if (UA_Variant_copy(value, &entry.value) != UA_STATUSCODE_GOOD) {
+                values.erase(it);
+                return;
+            }
+        }
+        entry.status = UA_STATUSCODE_GOOD;
+        entry.source_timestamp = now;
+    }
+
+    // drops the stored value, so that the next read goes to the device
+    void invalidate(UA_UInt32 identifier) {
+        std::scoped_lock<std::mutex> guard(mutex);
+        const auto it = values.find(identifier);
+        if (it != values.end()) {
+            UA_Variant_clear(&it->second.value);
+            UA_Variant_clear(&it->second.published);
+            values.erase(it);
+        }
+    }
+
+    // keeps all stored values as last usable values, e.g. while the device is disconnected
+    void mark_stale() {
+        std::scoped_lock<std::mutex> guard(mutex);
+        for (auto& [_, entry] : values) {
+            entry.status = UA_STATUSCODE_UNCERTAINLASTUSABLEVALUE;
+        }
+    }
+
+    void clear() {
+        std::scoped_lock<std::mutex> guard(mutex);
+        for (auto& [_, entry] : values) {
+            UA_Variant_clear(&entry.value);
+            UA_Variant_clear(&entry.published);
+        }
+        values.clear();
+    }
+
+   private:
+    mutable std::mutex mutex;
+    std::unordered_map<UA_UInt32, ShadowValue> values;
+};
\ No newline at end of file
@@ -4,12 +4,15 @@
 #include <open62541/plugin/log_stdout.h>
 #include <re2/re2.h>
 
+#include <algorithm>
 #include <bit>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <numeric>
 #include <optional>
 #include <string>
@@ -27,6 +30,10 @@ class SLMP {
     enum class RequestCommand : uint16_t {
         Read = 0x0401,
         Write = 0x1401,
+        RandomRead = 0x0403,
+        BlockRead = 0x0406,
+        MonitorRegistration = 0x0801,
+        Monitor = 0x0802,
         ArrayLabelRead = 0x041A,
         ArrayLabelWrite = 0x141A,
         RandomLabelRead = 0x041c,
@@ -81,10 +88,16 @@ class SLMP {
         HG = 0x002E
     };
 
+    // subheader of the request frame
     enum class Serialnumber : uint16_t {
-        None = 0x0050,
+        None = 0x0050,    // 3E frame
+        Serial = 0x0054,  // 4E frame, followed by a serial number
     };
 
+    // 3E frames are answered strictly in order, 4E frames carry a serial number so that several requests can be in
+    // flight on one connection
+    enum class Frame { E3, E4 };
+
     enum class NetworkNumber : uint8_t { A = 0x00 };
 
     enum class StationNumber : uint8_t { A = 0xFF };
@@ -139,11 +152,26 @@ class SLMP {
         InvalidGlobalLabel = 0x40C0
     };
 
+    // label name as it is sent in label requests, the number of characters followed by the utf-16 characters
+    static std::vector<std::byte> encode_label(const std::string& label) {
+        std::vector<std::byte> encoded_label;
+        encoded_label.reserve(2 + 2 * label.size());
+        encoded_label.push_back(static_cast<std::byte>(label.size()));
+        encoded_label.push_back(static_cast<std::byte>(label.size() >> 8));
+        for (const char character : label) {
+            encoded_label.push_back(static_cast<std::byte>(character));
+            encoded_label.push_back(std::byte{0});
+        }
+        return encoded_label;
+    }
+
     struct Command {
         bool is_label;
         Device device;
         DeviceExtension device_extension;
         std::string label;
+        // encoded once, so that label requests don't have to encode the name again
+        std::vector<std::byte> encoded_label;
         uint32_t head_no;
         uint16_t length;
 
@@ -152,6 +180,7 @@ class SLMP {
               device{Device::None},
               device_extension{DeviceExtension::None},
               label{std::move(label)},
+              encoded_label{encode_label(this->label)},
               head_no{},
               length{} {}
 
@@ -223,6 +252,43 @@ class SLMP {
         }
     };
 
+    // one array of an array label read or write request, encoded_label is the name of the label with the index of the
+    // first element (e.g. `label[4]`) as returned by encode_label. the data length of bit arrays is given in bits, of
+    // all other arrays in bytes
+    struct ArrayLabel {
+        std::vector<std::byte> encoded_label;
+        bool bit_unit;
+        uint16_t data_length;
+    };
+
+    // request data that is encoded once with encode and then sent any number of times without encoding it again
+    struct EncodedRequest {
+        RequestCommand command;
+        Subcommand subcommand;
+        std::vector<std::byte> data;
+    };
+
+    static bool is_bit_device(Device device) {
+        switch (device) {
+            case Device::SM:
+            case Device::X:
+            case Device::Y:
+            case Device::M:
+            case Device::L:
+            case Device::F:
+            case Device::V:
+            case Device::B:
+            case Device::TS:
+            case Device::TC:
+            case Device::SB:
+            case Device::DX:
+            case Device::DY:
+                return true;
+            default:
+                return false;
+        }
+    }
+
     SLMP(std::string addr, int port, uint8_t network_no, uint8_t station_no, uint16_t module_io,
          uint8_t multidrop_station_no)
         : connected{false},
@@ -245,74 +311,112 @@ class SLMP {
     void disconnect() {
         UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Disconnected");
         connected = false;
+        // the rest of a partially received response never arrives on the next connection
+        response_received = 0;
+        receiving_size = 0;
     }
 
     void connect() {
-        const auto result = socket.connect();
-        if (!result.has_value()) {
-#ifdef WIN32
-            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Couldn't connect to plc at address '%s:%d' %d",
-                        socket.addr, socket.port, WSAGetLastError());
-#else
-            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Couldn't connect to plc at address '%s:%d'",
-                        socket.addr, socket.port);
-#endif
-            this->disconnect();
+        if (!socket.connect(connect_timeout_ms, request_timeout_ms).has_value()) {
+            connect_failed();
             return;
         }
-        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Connected with plc at address '%s:%d'", socket.addr,
-                    socket.port);
-        connected = true;
+        connection_established();
+    }
+
+    // starts connecting without blocking, the returned socket becomes writable once the connect completed, which is
+    // then checked with finish_connect
+    std::optional<SocketHandle> connect_async() {
+        connected = false;
+        const auto handle = socket.connect_async();
+        if (!handle.has_value()) {
+            connect_failed();
+        }
+        return handle;
+    }
+
+    // completes a connect started with connect_async, writable is false if the socket didn't become writable in time
+    void finish_connect(bool writable) {
+        if (!writable || !socket.finish_connect(request_timeout_ms)) {
+            connect_failed();
+            return;
+        }
+        connection_established();
     }
 
     ~SLMP() {}
 
     std::optional<std::pair<std::byte*, std::size_t>> read_request(Device device, DeviceExtension device_extension,
                                                                    uint32_t head_no, uint16_t count) {
-        auto subcommand = Subcommand::Word;  // default to 0000 subcommand instead of 0002
-        if (device_extension != DeviceExtension::None) {
-            subcommand = Subcommand::WordLongDeviceExtension;  // default to 0082 subcommand instead of 0080
-            request_data.push_back(std::byte{0});
-            request_data.push_back(std::byte{0});
-            request_data.push_back(static_cast<std::byte>(head_no));
-            request_data.push_back(static_cast<std::byte>(head_no >> 8));
-            request_data.push_back(static_cast<std::byte>(head_no >> 16));
-            request_data.push_back(static_cast<std::byte>(head_no >> 24));
-            request_data.push_back(static_cast<std::byte>(device));
-            request_data.push_back(static_cast<std::byte>(static_cast<uint16_t>(device) >> 8));
-            request_data.push_back(std::byte{0});
-            request_data.push_back(std::byte{0});
-            request_data.push_back(static_cast<std::byte>(device_extension));
-            request_data.push_back(static_cast<std::byte>(static_cast<uint16_t>(device_extension) >> 8));
-            if (device_extension == DeviceExtension::CPUNo1 || device_extension == DeviceExtension::CPUNo2 ||
-                device_extension == DeviceExtension::CPUNo3 || device_extension == DeviceExtension::CPUNo4) {
-                // cpu buffer memory access
-                request_data.push_back(std::byte{0xFA});
-            } else {
-                // module access
-                request_data.push_back(std::byte{0xF8});
-            }
-        } else {
-            request_data.push_back(static_cast<std::byte>(head_no));
-            request_data.push_back(static_cast<std::byte>(head_no >> 8));
-            request_data.push_back(static_cast<std::byte>(head_no >> 16));
-            request_data.push_back(static_cast<std::byte>(device));
-        }
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        const auto [command, subcommand] = push_read_request(device, device_extension, head_no, count);
+        return response_data(request(command, subcommand));
+    }
+
+    // appends the data of a read request without sending it, see pipeline
+    std::pair<RequestCommand, Subcommand> push_read_request(Device device, DeviceExtension device_extension,
+                                                            uint32_t head_no, uint16_t count) {
+        const bool extended = device_extension != DeviceExtension::None;
+        // default to 0000/0082 subcommand instead of 0002/0080
+        const auto subcommand = extended ? Subcommand::WordLongDeviceExtension : Subcommand::Word;
+        push_device(device, device_extension, head_no, extended);
         request_data.push_back(static_cast<std::byte>(count));
         request_data.push_back(static_cast<std::byte>(count >> 8));
+        return {RequestCommand::Read, subcommand};
+    }
+
+    // reads single words and double words of arbitrary devices with one random read request (0x0403), the words are
+    // returned before the double words, both in the order of the commands
+    std::optional<std::pair<std::byte*, std::size_t>> random_read_request(
+        tcb::span<const Command> word_commands, tcb::span<const Command> double_word_commands) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        const auto subcommand = push_random_devices(word_commands, double_word_commands);
+        return response_data(request(RequestCommand::RandomRead, subcommand));
+    }
 
-        const auto retval = request(RequestCommand::Read, subcommand);
+    // registers the words and double words that are returned by later monitor requests (0x0801), the commands are
+    // encoded like in a random read request. the plc keeps the registration only for the current connection
+    bool monitor_registration_request(tcb::span<const Command> word_commands,
+                                      tcb::span<const Command> double_word_commands) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        const auto subcommand = push_random_devices(word_commands, double_word_commands);
+        monitor_registered = response_data(request(RequestCommand::MonitorRegistration, subcommand)).has_value();
+        return monitor_registered;
+    }
 
-        if (retval.has_value() && buffer.size() >= 12) {
-            const auto end_code = std::to_integer<uint32_t>(buffer[9]) + (std::to_integer<uint32_t>(buffer[10]) << 8);
+    // reads the registered devices (0x0802), the response has the layout of the matching random read response
+    std::optional<std::pair<std::byte*, std::size_t>> monitor_request() {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        return response_data(request(RequestCommand::Monitor, Subcommand::Word));
+    }
 
-            if (end_code != 0) {
-                return {};
-            }
+    // the command of a monitor request without sending it, see pipeline
+    static std::pair<RequestCommand, Subcommand> push_monitor_request() {
+        return {RequestCommand::Monitor, Subcommand::Word};
+    }
 
-            return {{&buffer[11], buffer.size() - 12}};
+    // reads several blocks of consecutive words with one block read request (0x0406), the length of a command is the
+    // number of words of its block. the blocks of word devices are returned before the blocks of bit devices, both in
+    // the order of the commands
+    std::optional<std::pair<std::byte*, std::size_t>> block_read_request(tcb::span<const Command> commands) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        const bool extended = has_device_extension(commands);
+        const auto subcommand = extended ? Subcommand::WordLongDeviceExtension : Subcommand::Word;
+        const auto bit_blocks = static_cast<std::size_t>(std::count_if(
+            commands.begin(), commands.end(), [](const Command& command) { return is_bit_device(command.device); }));
+        request_data.push_back(static_cast<std::byte>(commands.size() - bit_blocks));
+        request_data.push_back(static_cast<std::byte>(bit_blocks));
+        for (const bool bit_device : {false, true}) {
+            for (const auto& command : commands) {
+                if (is_bit_device(command.device) == bit_device) {
+                    push_device(command.device, command.device_extension, command.head_no, extended);
+                    request_data.push_back(static_cast<std::byte>(command.length));
+                    request_data.push_back(static_cast<std::byte>(command.length >> 8));
+                }
+            }
         }
-        return {};
+
+        return response_data(request(RequestCommand::BlockRead, subcommand));
     }
 
     template <class T, WriteType write_type>
@@ -335,38 +439,16 @@ class SLMP {
 
         assert((write_data_size + header_size + 6) <= request_data_size && "Write request too big");
 
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+
         auto subcommand = write_type == WriteType::Word
                               ? Subcommand::Word
                               : Subcommand::Bit;  // default to 0000/0001 subcommand instead of 0002/0003
         if (device_extension != DeviceExtension::None) {
             assert(write_type == WriteType::Word && "Writing with device extension is only allowed for word type");
             subcommand = Subcommand::WordLongDeviceExtension;  // default to 0082 subcommand instead of 0080
-            request_data.push_back(std::byte{0});
-            request_data.push_back(std::byte{0});
-            request_data.push_back(static_cast<std::byte>(head_no));
-            request_data.push_back(static_cast<std::byte>(head_no >> 8));
-            request_data.push_back(static_cast<std::byte>(head_no >> 16));
-            request_data.push_back(static_cast<std::byte>(head_no >> 24));
-            request_data.push_back(static_cast<std::byte>(device));
-            request_data.push_back(static_cast<std::byte>(static_cast<uint16_t>(device) >> 8));
-            request_data.push_back(std::byte{0});
-            request_data.push_back(std::byte{0});
-            request_data.push_back(static_cast<std::byte>(device_extension));
-            request_data.push_back(static_cast<std::byte>(static_cast<uint16_t>(device_extension) >> 8));
-            if (device_extension == DeviceExtension::CPUNo1 || device_extension == DeviceExtension::CPUNo2 ||
-                device_extension == DeviceExtension::CPUNo3 || device_extension == DeviceExtension::CPUNo4) {
-                // cpu buffer memory access
-                request_data.push_back(std::byte{0xFA});
-            } else {
-                // module access
-                request_data.push_back(std::byte{0xF8});
-            }
-        } else {
-            request_data.push_back(static_cast<std::byte>(head_no));
-            request_data.push_back(static_cast<std::byte>(head_no >> 8));
-            request_data.push_back(static_cast<std::byte>(head_no >> 16));
-            request_data.push_back(static_cast<std::byte>(device));
         }
+        push_device(device, device_extension, head_no, device_extension != DeviceExtension::None);
         request_data.push_back(static_cast<std::byte>(device_count));
         request_data.push_back(static_cast<std::byte>(device_count >> 8));
 
@@ -382,54 +464,342 @@ class SLMP {
             request_data.resize(request_data.size() + write_data_size);
             std::memcpy(&request_data.back() - write_data_size + 1, data.data(), data.size() * sizeof(T));
         }
-        const auto retval = request(RequestCommand::Write, subcommand);
-        if (retval.has_value() && buffer.size() >= 10) {
-            const auto end_code = std::to_integer<uint32_t>(buffer[9]) + (std::to_integer<uint32_t>(buffer[10]) << 8);
+        if (response_data(request(RequestCommand::Write, subcommand)).has_value()) {
+            return 1;
+        }
+        return {};
+    }
 
-            if (end_code != 0) {
-                return {};
+    // reads label_count labels with one random label read request (0x041C), encoded_labels are the names of the labels
+    // as returned by encode_label. the data of the response can be split into the data of every label with
+    // split_label_data
+    std::optional<std::pair<std::byte*, std::size_t>> random_label_read_request(
+        std::size_t label_count, tcb::span<const std::byte> encoded_labels) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        const auto [command, subcommand] = push_random_label_read_request(label_count, encoded_labels);
+        return response_data(request(command, subcommand));
+    }
+
+    // appends the data of a random label read request without sending it, see pipeline
+    std::pair<RequestCommand, Subcommand> push_random_label_read_request(std::size_t label_count,
+                                                                         tcb::span<const std::byte> encoded_labels) {
+        request_data.push_back(static_cast<std::byte>(label_count));
+        request_data.push_back(static_cast<std::byte>(label_count >> 8));
+        request_data.push_back(std::byte{0});
+        request_data.push_back(std::byte{0});
+        request_data.insert(request_data.end(), encoded_labels.begin(), encoded_labels.end());
+        return {RequestCommand::RandomLabelRead, Subcommand::Word};
+    }
+
+    // splits the data of a random label read response into the data of every label, returns false if the response
+    // doesn't contain data for all labels
+    static bool split_label_data(const std::byte* data, std::size_t size,
+                                 tcb::span<std::pair<const std::byte*, std::size_t>> labels) {
+        if (size < 2 || (std::to_integer<std::size_t>(data[0]) + (std::to_integer<std::size_t>(data[1]) << 8)) !=
+                            labels.size()) {
+            return false;
+        }
+        std::size_t start_index = 2;
+        for (auto& label : labels) {
+            // 1 byte data type, 2 bytes data length
+            if (size < (start_index + 3)) {
+                return false;
+            }
+            const std::size_t data_size = std::to_integer<std::size_t>(data[start_index + 1]) +
+                                          (std::to_integer<std::size_t>(data[start_index + 2]) << 8);
+            if (size < (start_index + 3 + data_size)) {
+                return false;
             }
+            label = {data + start_index + 3, data_size};
+            start_index += 3 + data_size;
+        }
+        return true;
+    }
 
-            return 1;
+    // reads arrays with one array label read request (0x041A), the data of the response can be split into the data of
+    // every array with split_array_label_data
+    std::optional<std::pair<std::byte*, std::size_t>> array_label_read_request(tcb::span<const ArrayLabel> arrays) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        const auto [command, subcommand] = push_array_label_read_request(arrays);
+        return response_data(request(command, subcommand));
+    }
+
+    // appends the data of an array label read request without sending it, see pipeline
+    std::pair<RequestCommand, Subcommand> push_array_label_read_request(tcb::span<const ArrayLabel> arrays) {
+        request_data.push_back(static_cast<std::byte>(arrays.size()));
+        request_data.push_back(static_cast<std::byte>(arrays.size() >> 8));
+        request_data.push_back(std::byte{0});
+        request_data.push_back(std::byte{0});
+        for (const auto& array : arrays) {
+            push_array_label(array);
         }
-        return {};
+        return {RequestCommand::ArrayLabelRead, Subcommand::Word};
     }
 
-    template <class T>
-    std::optional<int32_t> label_array_read_request(std::string label_name, tcb::span<T> label_data) {
-        std::vector<std::string> label_names;
-        label_names.reserve(label_data.size());
-        for (std::size_t i = 0; i < label_data.size(); i++) {
-            label_names.emplace_back(fmt::format(fmt::runtime(label_name + "[{}]"), i));
+    // encodes the request that push appends with one of the push_*_request functions, the request is not sent
+    template <typename Push>
+    EncodedRequest encode(Push push) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        const auto [command, subcommand] = push();
+        EncodedRequest encoded{command,
+                               subcommand,
+                               {request_data.begin() + static_cast<std::ptrdiff_t>(header_size), request_data.end()}};
+        discard_request();
+        return encoded;
+    }
+
+    // appends the data of an encoded request without sending it, see pipeline
+    std::pair<RequestCommand, Subcommand> push_encoded_request(const EncodedRequest& encoded) {
+        request_data.insert(request_data.end(), encoded.data.begin(), encoded.data.end());
+        return {encoded.command, encoded.subcommand};
+    }
+
+    // drops the data appended by the push_*_request functions without sending it
+    void discard_request() {
+        request_data.resize(header_size);
+    }
+
+    // sends count requests with up to max_pending_requests of them in flight, prepare(i) appends the data of request i
+    // with one of the push_*_request functions and returns its command. handle(i, data) is called with the response
+    // data of request i, which is empty if the request failed, responses are matched to their requests by serial
+    // number. with 3E frames the requests are sent one after another
+    template <typename Prepare, typename Handle>
+    void pipeline(std::size_t count, Prepare prepare, Handle handle) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        start_pipeline(count);
+        bool timed_out = false;
+        while (!pipeline_step(prepare, handle, timed_out)) {
+            timed_out = !socket.readable_until(pipeline_deadline);
         }
-        return label_read_request(label_names, label_data);
     }
 
-    template <class T>
-    std::optional<int32_t> label_read_request(const tcb::span<std::string> label_names, tcb::span<T> label_data) {
-        request_data.push_back(static_cast<std::byte>(label_names.size()));
-        request_data.push_back(static_cast<std::byte>(label_names.size() >> 8));
+    // starts a pipeline of count requests like pipeline, which is continued with pipeline_step instead of waiting for
+    // the responses
+    void start_pipeline(std::size_t count) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        abort_pipeline();
+        pending_requests.clear();
+        pipeline_count = count;
+        pipeline_next = 0;
+        pipeline_running = true;
+        pipeline_deadline = Socket::deadline(request_timeout_ms);
+    }
+
+    // continues the pipeline started with start_pipeline without waiting: sends the requests that fit into the window
+    // and handles the responses that already arrived. returns true once every request was handled, otherwise the
+    // pipeline is continued once the socket (socket_handle) is readable, or with timed_out once response_deadline
+    // passed, which drops the connection
+    template <typename Prepare, typename Handle>
+    bool pipeline_step(Prepare&& prepare, Handle&& handle, bool timed_out = false) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        if (!pipeline_running) {
+            return true;
+        }
+        if (timed_out && connected) {
+            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Plc at address '%s:%d' didn't respond in time",
+                        socket.addr, socket.port);
+            this->disconnect();
+        }
+        const std::size_t max_pending = frame == Frame::E4 ? std::max<std::size_t>(max_pending_requests, 1) : 1;
+        auto& pending = pending_requests;
+        while (pipeline_next < pipeline_count || !pending.empty()) {
+            while (pipeline_next < pipeline_count && pending.size() < max_pending) {
+                std::optional<uint16_t> serial;
+                if (connected) {
+                    const auto [command, subcommand] = prepare(pipeline_next);
+                    serial = send_request(command, subcommand);
+                }
+                if (serial.has_value()) {
+                    pending.emplace_back(serial.value(), pipeline_next);
+                } else {
+                    handle(pipeline_next, std::optional<std::pair<std::byte*, std::size_t>>{});
+                }
+                pipeline_next++;
+            }
+            if (pending.empty()) {
+                continue;
+            }
+            if (!connected) {
+                // all requests in flight are lost with the connection
+                for (const auto& [_, index] : pending) {
+                    handle(index, std::optional<std::pair<std::byte*, std::size_t>>{});
+                }
+                pending.clear();
+                continue;
+            }
+            const auto received = receive_available();
+            if (received == Receive::Waiting) {
+                return false;
+            }
+            if (received == Receive::Failed) {
+                continue;
+            }
+            pipeline_deadline = Socket::deadline(request_timeout_ms);
+            const auto serial = frame == Frame::E4 ? response_serial() : pending.front().first;
+            const auto it = std::find_if(pending.begin(), pending.end(),
+                                         [serial](const auto& request) { return request.first == serial; });
+            if (it != pending.end()) {
+                const auto index = it->second;
+                pending.erase(it);
+                handle(index, response_data(completed_length));
+            }
+        }
+        pipeline_running = false;
+        return true;
+    }
+
+    // drops the connection if a pipeline didn't finish, e.g. as its step threw or it was abandoned with requests in
+    // flight, their responses would be taken for the responses of the next requests
+    void abort_pipeline() {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        if (!pipeline_running) {
+            return;
+        }
+        pipeline_running = false;
+        pending_requests.clear();
+        if (connected) {
+            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Plc at address '%s:%d' has requests in flight",
+                        socket.addr, socket.port);
+            this->disconnect();
+        }
+    }
+
+    // the socket that a pipeline waits on for its responses
+    SocketHandle socket_handle() const {
+        return socket.handle();
+    }
+
+    // time at which the response that a pipeline waits for is overdue
+    std::chrono::steady_clock::time_point response_deadline() const {
+        return pipeline_deadline.value_or(std::chrono::steady_clock::time_point::max());
+    }
+
+    // switches between 3E and 4E frames
+    void set_frame(Frame new_frame) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        if (new_frame == frame) {
+            return;
+        }
+        request_data.resize(header_size);
+        if (new_frame == Frame::E4) {
+            // serial number and 2 fixed `0 bytes` after the subheader
+            request_data[0] = static_cast<std::byte>(Serialnumber::Serial);
+            request_data.insert(request_data.begin() + 2, 4, std::byte{0});
+        } else {
+            request_data[0] = static_cast<std::byte>(Serialnumber::None);
+            request_data.erase(request_data.begin() + 2, request_data.begin() + 6);
+        }
+        frame = new_frame;
+        header_size = request_data.size();
+    }
+
+    // writes arrays with one array label write request (0x141A), data holds the data of every array
+    bool array_label_write_request(tcb::span<const ArrayLabel> arrays, tcb::span<const std::vector<std::byte>> data) {
+        assert(arrays.size() == data.size() && "every array needs data");
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        request_data.push_back(static_cast<std::byte>(arrays.size()));
+        request_data.push_back(static_cast<std::byte>(arrays.size() >> 8));
         request_data.push_back(std::byte{0});
         request_data.push_back(std::byte{0});
+        for (std::size_t i = 0; i < arrays.size(); i++) {
+            push_array_label(arrays[i]);
+            request_data.insert(request_data.end(), data[i].begin(), data[i].end());
+            request_data.resize(request_data.size() + array_label_data_size(arrays[i]) - data[i].size());
+        }
 
-        for (std::size_t i = 0; i < label_names.size(); i++) {
-            request_data.push_back(static_cast<std::byte>(label_names[i].size()));
-            request_data.push_back(static_cast<std::byte>(label_names[i].size() >> 8));
-            for (std::size_t j = 0; j < label_names[i].size(); j++) {
-                request_data.push_back(static_cast<std::byte>(label_names[i][j]));
-                request_data.push_back(std::byte{0});
+        return response_data(request(RequestCommand::ArrayLabelWrite, Subcommand::Word)).has_value();
+    }
+
+    // splits the data of an array label read response into the data of every array, returns false if the response
+    // doesn't contain data for all arrays
+    static bool split_array_label_data(const std::byte* data, std::size_t size,
+                                       tcb::span<std::pair<const std::byte*, std::size_t>> arrays) {
+        if (size < 2 || (std::to_integer<std::size_t>(data[0]) + (std::to_integer<std::size_t>(data[1]) << 8)) !=
+                            arrays.size()) {
+            return false;
+        }
+        std::size_t start_index = 2;
+        for (auto& array : arrays) {
+            // 1 byte data type, 1 byte unit, 2 bytes data length
+            if (size < (start_index + 4)) {
+                return false;
+            }
+            const bool bit_unit = data[start_index + 1] == std::byte{0};
+            const std::size_t data_length = std::to_integer<std::size_t>(data[start_index + 2]) +
+                                            (std::to_integer<std::size_t>(data[start_index + 3]) << 8);
+            const auto data_size = bit_unit ? (data_length + 15) / 16 * 2 : data_length;
+            if (size < (start_index + 4 + data_size)) {
+                return false;
             }
+            array = {data + start_index + 4, data_size};
+            start_index += 4 + data_size;
         }
-        const auto retval = request(RequestCommand::RandomLabelRead, Subcommand::Word);
+        return true;
+    }
+
+    // number of bytes of the data of array in a request or response, bits are sent in units of words
+    static std::size_t array_label_data_size(const ArrayLabel& array) {
+        return array.bit_unit ? (array.data_length + 15u) / 16u * 2u : array.data_length;
+    }
+
+    // elements [start, start + count) of the array label of command, element_size is 0 for bit arrays
+    static ArrayLabel array_label(const Command& command, std::size_t start, std::size_t count,
+                                  std::size_t element_size) {
+        return {encode_label(fmt::format("{}[{}]", command.label, start)), element_size == 0,
+                static_cast<uint16_t>(element_size == 0 ? count : count * element_size)};
+    }
+
+    // max number of elements of the array label of command that fit into one request and its response
+    std::size_t max_array_label_elements(const Command& command, std::size_t element_size) const {
+        // 2 bytes array count, 2 bytes abbreviations, the label name with an index of up to 8 digits, 1 byte unit,
+        // 1 byte fixed value, 2 bytes data length
+        const auto request_size = max_request_data_size() - 4 - (command.encoded_label.size() + 2 * 10) - 4;
+        // 2 bytes array count, 1 byte data type, 1 byte unit, 2 bytes data length
+        const auto response_size = max_response_data_size() - 6;
+        const auto size = std::min(request_size, response_size);
+        return element_size == 0 ? size / 2 * 16 : size / element_size;
+    }
 
-        if (retval.has_value()) {
-            return response(RequestCommand::RandomLabelRead, Subcommand::Word, label_data, buffer.size());
+    // size of a string label in bytes, the string is terminated with 1 or 2 `0 bytes`
+    static std::size_t label_string_size(const Command& command) {
+        return ((command.length != 0 ? command.length : default_label_string_length) + 2u) / 2u * 2u;
+    }
+
+    // size of one element of an array label of Type in bytes, 0 for bit arrays
+    template <typename Type>
+    static std::size_t array_label_element_size(const Command& command) {
+        if constexpr (std::is_same_v<Type, uint8_t>) {
+            return 0;
+        } else if constexpr (std::is_same_v<Type, std::string>) {
+            return label_string_size(command);
+        } else {
+            return sizeof(Type);
         }
-        return retval;
+    }
+
+    // decodes the data of one array of an array label read response, data is left untouched if the response is too
+    // short
+    template <typename Type>
+    static void decode_array_label(const Command& command, const std::byte* array_data, std::size_t size,
+                                   tcb::span<Type> data);
+
+    // appends the data of one array of an array label write request
+    template <typename Type>
+    static void encode_array_label(const Command& command, tcb::span<const Type> data,
+                                   std::vector<std::byte>& array_data);
+
+    // space for the data after the command and subcommand of a request and after the end code of a response
+    std::size_t max_request_data_size() const {
+        return request_data_size - header_size;
+    }
+
+    std::size_t max_response_data_size() const {
+        return buffer_size - response_header_size();
     }
 
     template <class T>
     std::optional<int32_t> label_write_request(const tcb::span<std::string> label_names, tcb::span<T> label_data) {
+        const std::lock_guard<std::recursive_mutex> lock(this->mutex);
         auto write_data_length = 2 * ((sizeof(T) + 1) / 2);  // to round uint8_t up to 2
 
         request_data.push_back(static_cast<std::byte>(label_names.size()));
@@ -461,169 +831,521 @@ class SLMP {
     }
 
     volatile bool connected;
+    // max time in ms a connect may take
+    int connect_timeout_ms = 5000;
+    // max time in ms the plc may take for a response before the connection is dropped, 0 waits forever. a device
+    // that goes silent holds a worker of the reactor for this long, so it is kept well below the connect timeout
+    int request_timeout_ms = 2000;
+    // whether the devices for monitor requests are registered on the current connection
+    bool monitor_registered = false;
+    // max number of requests in flight in a pipeline with 4E frames
+    std::size_t max_pending_requests = 8;
+
+    // locks the connection for a sequence of requests, so that a batch is not interleaved with other requests
+    std::unique_lock<std::recursive_mutex> lock() {
+        return std::unique_lock<std::recursive_mutex>(this->mutex);
+    }
+
+    // max number of words that fit into one read request and its response
+    std::size_t max_read_words() const {
+        return std::min(max_read_points, max_response_data_size() / sizeof(uint16_t));
+    }
+
+    // max number of words and double words of one random read request or monitor registration
+    static std::size_t max_random_read_words(bool extended) {
+        return extended ? max_random_read_extended_points : max_random_read_points;
+    }
+
+    // number of words that have to be read from the device for count values of Type
+    template <typename Type>
+    static std::size_t word_count(const Command& command, std::size_t count);
+
+    // decodes the words returned by read_request into data, data is left untouched if not enough words were read
+    template <typename Type>
+    static void decode(const Command& command, const std::byte* words, std::size_t size, tcb::span<Type> data);
 
     template <typename Type>
     Type get(const Command& command);
 
+    // reads one value of Type for each command with as few random read or block read requests as possible,
+    // returns false if any of the requests failed
+    template <typename Type>
+    bool get_many(tcb::span<const Command> commands, tcb::span<Type> data);
+
     template <typename Type>
     void get(const Command& command, tcb::span<Type> data);
 
     template <typename Type>
     bool write(const Command& command, Type value);
 
+    // writes an array, only global labels are supported
+    template <typename Type>
+    bool write(const Command& command, tcb::span<const Type> data);
+
    private:
-    template <class T>
-    std::optional<int32_t> response(RequestCommand command, Subcommand subcommand, tcb::span<T> read_data,
-                                    std::size_t response_length) {
-        if (response_length < 11) {
-            return {};
-        }
+    void connect_failed() {
+#ifdef WIN32
+        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Couldn't connect to plc at address '%s:%d' %d",
+                    socket.addr, socket.port, WSAGetLastError());
+#else
+        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Couldn't connect to plc at address '%s:%d'",
+                    socket.addr, socket.port);
+#endif
+        this->disconnect();
+    }
+
+    void connection_established() {
+        UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Connected with plc at address '%s:%d'", socket.addr,
+                    socket.port);
+        monitor_registered = false;
+        pipeline_running = false;
+        connected = true;
+    }
 
-        const auto end_code = std::to_integer<uint32_t>(buffer[9]) + (std::to_integer<uint32_t>(buffer[10]) << 8);
+    std::string ip_addr;
+    Socket socket;
+    // large enough for the biggest response of a read request (960 words)
+    std::size_t buffer_size = 2048;
+    std::vector<std::byte> buffer;
+    std::size_t request_data_size = 1296;
+    std::size_t header_size;
+    Frame frame = Frame::E3;
+    uint16_t next_serial = 0;
+    // serial number and index of the requests in flight in pipeline, kept so that a pipeline doesn't allocate
+    std::vector<std::pair<uint16_t, std::size_t>> pending_requests;
+    // progress of the pipeline that pipeline_step continues
+    std::size_t pipeline_count = 0;
+    std::size_t pipeline_next = 0;
+    bool pipeline_running = false;
+    std::optional<std::chrono::steady_clock::time_point> pipeline_deadline;
+    // bytes of the response that receive_available received so far and its length, which is 0 until the header of
+    // the response arrived
+    std::size_t response_received = 0;
+    std::size_t receiving_size = 0;
+    // length of the response that receive_available completed, nothing if it was dropped as it exceeds the buffer
+    std::optional<int> completed_length;
+    // limits of the read, random read and block read commands
+    static constexpr std::size_t max_read_points = 960;
+    static constexpr std::size_t max_random_read_points = 192;
+    static constexpr std::size_t max_random_read_extended_points = 96;
+    static constexpr std::size_t max_block_read_blocks = 120;
+    static constexpr std::size_t max_block_read_points = 960;
+    // length of string labels without a length
+    static constexpr std::size_t default_label_string_length = 32;
+    std::vector<std::byte> request_data;
+    // request_data and buffer are shared by the poller and the server thread, the lock is held until the answer in
+    // buffer is decoded
+    std::recursive_mutex mutex;
 
-        if (end_code != 0) {
-            return {};
+    void push_array_label(const ArrayLabel& array) {
+        request_data.insert(request_data.end(), array.encoded_label.begin(), array.encoded_label.end());
+        request_data.push_back(array.bit_unit ? std::byte{0} : std::byte{1});
+        request_data.push_back(std::byte{0});
+        request_data.push_back(static_cast<std::byte>(array.data_length));
+        request_data.push_back(static_cast<std::byte>(array.data_length >> 8));
+    }
+
+    // appends the point counts and devices of a random read or monitor registration request
+    Subcommand push_random_devices(tcb::span<const Command> word_commands,
+                                   tcb::span<const Command> double_word_commands) {
+        const bool extended = has_device_extension(word_commands) || has_device_extension(double_word_commands);
+        request_data.push_back(static_cast<std::byte>(word_commands.size()));
+        request_data.push_back(static_cast<std::byte>(double_word_commands.size()));
+        for (const auto& command : word_commands) {
+            push_device(command.device, command.device_extension, command.head_no, extended);
+        }
+        for (const auto& command : double_word_commands) {
+            push_device(command.device, command.device_extension, command.head_no, extended);
         }
+        return extended ? Subcommand::WordLongDeviceExtension : Subcommand::Word;
+    }
 
-        std::size_t i = 0;
-        if (command == RequestCommand::Read) {
-            if (subcommand == Subcommand::Word || subcommand == Subcommand::WordLong ||
-                subcommand == Subcommand::WordLongDeviceExtension) {
-                if (response_length < (11 + read_data.size() * sizeof(T))) {
-                    return {};
-                }
-                std::memcpy(read_data.data(), buffer.data() + 11, read_data.size() * sizeof(T));
-            } else if constexpr (!std::is_same_v<T, std::string>) {
-                if (response_length < 12) {
-                    return {};
-                }
+    static bool has_device_extension(tcb::span<const Command> commands) {
+        return std::any_of(commands.begin(), commands.end(),
+                           [](const Command& command) { return command.device_extension != DeviceExtension::None; });
+    }
 
-                for (i = 0; i < (response_length - 11) * 2; i++) {
-                    read_data[i] = static_cast<T>((buffer[11 + i / 2] >> ((i % 2) ? 0 : 4)) & std::byte{0x0f});
-                }
+    // appends the device specification, extended specifications are used with subcommand 0082
+    void push_device(Device device, DeviceExtension device_extension, uint32_t head_no, bool extended) {
+        if (extended) {
+            request_data.push_back(std::byte{0});
+            request_data.push_back(std::byte{0});
+            request_data.push_back(static_cast<std::byte>(head_no));
+            request_data.push_back(static_cast<std::byte>(head_no >> 8));
+            request_data.push_back(static_cast<std::byte>(head_no >> 16));
+            request_data.push_back(static_cast<std::byte>(head_no >> 24));
+            request_data.push_back(static_cast<std::byte>(device));
+            request_data.push_back(static_cast<std::byte>(static_cast<uint16_t>(device) >> 8));
+            request_data.push_back(std::byte{0});
+            request_data.push_back(std::byte{0});
+            if (device_extension == DeviceExtension::None) {
+                // regular device inside of an extended request
+                request_data.push_back(std::byte{0});
+                request_data.push_back(std::byte{0});
+                request_data.push_back(std::byte{0});
+                return;
             }
-        } else if (command == RequestCommand::RandomLabelRead) {
-            if (response_length < 13) {
-                return {};
+            request_data.push_back(static_cast<std::byte>(device_extension));
+            request_data.push_back(static_cast<std::byte>(static_cast<uint16_t>(device_extension) >> 8));
+            if (device_extension == DeviceExtension::CPUNo1 || device_extension == DeviceExtension::CPUNo2 ||
+                device_extension == DeviceExtension::CPUNo3 || device_extension == DeviceExtension::CPUNo4) {
+                // cpu buffer memory access
+                request_data.push_back(std::byte{0xFA});
+            } else {
+                // module access
+                request_data.push_back(std::byte{0xF8});
             }
+        } else {
+            request_data.push_back(static_cast<std::byte>(head_no));
+            request_data.push_back(static_cast<std::byte>(head_no >> 8));
+            request_data.push_back(static_cast<std::byte>(head_no >> 16));
+            request_data.push_back(static_cast<std::byte>(device));
+        }
+    }
 
-            const std::size_t label_count =
-                std::to_integer<uint32_t>(buffer[11]) + (std::to_integer<uint32_t>(buffer[12]) << 8);
-            std::size_t start_index = 13;
-            for (i = 0; i < label_count; i++) {
-                if (response_length < (start_index + 2)) {
-                    return {};
-                }
+    // 4E frames have a serial number and 2 fixed `0 bytes` after the subheader
+    std::size_t frame_offset() const {
+        return frame == Frame::E4 ? 4 : 0;
+    }
 
-                const std::size_t data_size = std::to_integer<uint32_t>(buffer[start_index + 1]) +
-                                              (std::to_integer<uint32_t>(buffer[start_index + 2]) << 8);
+    // size of the response header including the end code
+    std::size_t response_header_size() const {
+        return 11 + frame_offset();
+    }
 
-                if (response_length < (start_index + 2 + data_size)) {
-                    return {};
-                }
+    uint16_t response_serial() const {
+        return static_cast<uint16_t>(std::to_integer<uint16_t>(buffer[2]) +
+                                     (std::to_integer<uint16_t>(buffer[3]) << 8));
+    }
 
-                if constexpr (std::is_same_v<T, std::string>) {
-                    // std::string
-                    read_data[i].assign(reinterpret_cast<char*>(&buffer.front() + start_index + 3), data_size);
-                } else {
-                    std::memcpy(&read_data[i], &buffer.front() + start_index + 3, sizeof(T));
-                }
-                start_index += 3 + data_size;
-            }
+    // response data after the end code
+    std::optional<std::pair<std::byte*, std::size_t>> response_data(std::optional<int> response_length) {
+        const auto header = response_header_size();
+        if (!response_length.has_value() || static_cast<std::size_t>(response_length.value()) < header) {
+            return {};
         }
-        return static_cast<int>(i);
-    }
+        const auto end_code = std::to_integer<uint32_t>(buffer[header - 2]) +
+                              (std::to_integer<uint32_t>(buffer[header - 1]) << 8);
 
-    std::string ip_addr;
-    Socket socket;
-    std::size_t buffer_size = 400;
-    std::vector<std::byte> buffer;
-    std::size_t request_data_size = 1296;
-    std::size_t header_size;
-    std::vector<std::byte> request_data;
+        if (end_code != 0) {
+            return {};
+        }
+
+        return {{&buffer[header], static_cast<std::size_t>(response_length.value()) - header}};
+    }
 
     std::optional<int> request(RequestCommand command, Subcommand subcommand) {
-        request_data[7] = static_cast<std::byte>(request_data.size() - header_size + 6);
-        request_data[8] = static_cast<std::byte>((request_data.size() - header_size + 6) >> 8);
-        request_data[11] = static_cast<std::byte>(command);
-        request_data[12] = static_cast<std::byte>(static_cast<uint16_t>(command) >> 8);
-        request_data[13] = static_cast<std::byte>(subcommand);
-        request_data[14] = static_cast<std::byte>(static_cast<uint16_t>(subcommand) >> 8);
+        if (pipeline_running) {
+            abort_pipeline();
+            discard_request();
+            return {};
+        }
+        const auto serial = send_request(command, subcommand);
+        if (!serial.has_value()) {
+            return {};
+        }
+        while (true) {
+            // with 4E frames, responses of requests that were abandoned in a failed pipeline are skipped
+            const auto response_length = receive_response();
+            if (!response_length.has_value() || frame == Frame::E3 || response_serial() == serial.value()) {
+                return response_length;
+            }
+        }
+    }
+
+    // sends the request in request_data, returns its serial number
+    std::optional<uint16_t> send_request(RequestCommand command, Subcommand subcommand) {
+        const auto offset = frame_offset();
+        const auto serial = next_serial++;
+        if (frame == Frame::E4) {
+            request_data[2] = static_cast<std::byte>(serial);
+            request_data[3] = static_cast<std::byte>(serial >> 8);
+        }
+        request_data[offset + 7] = static_cast<std::byte>(request_data.size() - header_size + 6);
+        request_data[offset + 8] = static_cast<std::byte>((request_data.size() - header_size + 6) >> 8);
+        request_data[offset + 11] = static_cast<std::byte>(command);
+        request_data[offset + 12] = static_cast<std::byte>(static_cast<uint16_t>(command) >> 8);
+        request_data[offset + 13] = static_cast<std::byte>(subcommand);
+        request_data[offset + 14] = static_cast<std::byte>(static_cast<uint16_t>(subcommand) >> 8);
         const auto send_result = socket.send(request_data.data(), request_data.size());
+        request_data.resize(header_size);
 
         if (!send_result.has_value()) {
-            request_data.resize(header_size);
             this->disconnect();
             return {};
         }
-        const auto recv_result = socket.recv(buffer.data(), buffer.size());
-        if (!recv_result.has_value()) {
-            request_data.resize(header_size);
-            this->disconnect();
-            return {};
+        return serial;
+    }
+
+    // receives exactly one response, waiting at most request_timeout_ms for it
+    std::optional<int> receive_response() {
+        const auto deadline = Socket::deadline(request_timeout_ms);
+        while (true) {
+            const auto received = receive_available();
+            if (received == Receive::Complete) {
+                return completed_length;
+            }
+            if (received == Receive::Failed) {
+                return {};
+            }
+            if (!socket.readable_until(deadline)) {
+                this->disconnect();
+                return {};
+            }
         }
+    }
 
-        request_data.resize(header_size);
-        return recv_result;
+    // receives what already arrived of the next response without waiting for more. a response can arrive in multiple
+    // tcp segments and pipelined responses can share one, so exactly one response is received, its length is taken
+    // from the response header. the length of a complete response is stored in completed_length
+    Receive receive_available() {
+        // 9 bytes header (13 bytes with 4E frames), the response data length includes the end code
+        const auto header_length = 9 + frame_offset();
+        while (true) {
+            const auto expected = receiving_size == 0 ? header_length : receiving_size;
+            // the rest of a response that doesn't fit into the buffer is dropped, the header is kept
+            const bool drop = expected > buffer_size;
+            const auto recv_result =
+                drop ? socket.recv_available(buffer.data() + header_length,
+                                             std::min(buffer_size - header_length, expected - response_received))
+                     : socket.recv_available(buffer.data() + response_received, expected - response_received);
+            if (!recv_result.has_value()) {
+                this->disconnect();
+                return Receive::Failed;
+            }
+            if (recv_result.value() == 0) {
+                return Receive::Waiting;
+            }
+            response_received += static_cast<std::size_t>(recv_result.value());
+            if (receiving_size == 0 && response_received == header_length) {
+                receiving_size = header_length + std::to_integer<std::size_t>(buffer[header_length - 2]) +
+                                  (std::to_integer<std::size_t>(buffer[header_length - 1]) << 8);
+                if (receiving_size > buffer_size) {
+                    UA_LOG_WARNING(&file_logger, UA_LOGCATEGORY_USERLAND, "Response of %zu bytes exceeds buffer size",
+                                   receiving_size);
+                }
+            }
+            if (receiving_size != 0 && response_received == receiving_size) {
+                completed_length = receiving_size > buffer_size ? std::nullopt
+                                                                 : std::optional<int>(static_cast<int>(receiving_size));
+                response_received = 0;
+                receiving_size = 0;
+                return Receive::Complete;
+            }
+        }
     }
 };
 
+template <typename Type>
+std::size_t SLMP::word_count(const Command& command, std::size_t count) {
+    if constexpr (std::is_same_v<Type, std::string>) {
+        return count * ((command.length + 1) / 2);
+    } else if constexpr (std::is_same_v<Type, uint8_t>) {
+        // array of booleans
+        return (count + 15) / 16;
+    } else {
+        return count * ((sizeof(Type) + 1) / sizeof(uint16_t));
+    }
+}
+
+template <typename Type>
+void SLMP::decode(const Command& command, const std::byte* words, std::size_t size, tcb::span<Type> data) {
+    if constexpr (std::is_same_v<Type, uint8_t>) {
+        // array of booleans
+        if (size < ((data.size() + 7) / 8)) {
+            return;
+        }
+
+        std::size_t index = 0;
+        for (auto& value : data) {
+            if (index % 8 < 4) {
+                value = (static_cast<uint8_t>(words[index / 8]) & (0x01 << (index % 4))) != 0;
+            } else {
+                value = (static_cast<uint8_t>(words[index / 8]) & (0x10 << (index % 4))) != 0;
+            }
+            index++;
+        }
+    } else if constexpr (std::is_same_v<Type, std::string>) {
+        if (size < (data.size() * command.length)) {
+            return;
+        }
+        for (std::size_t i = 0; i < data.size(); i++) {
+            data[i].assign(reinterpret_cast<const char*>(words + i * command.length), command.length);
+        }
+    } else {
+        if (size < (sizeof(Type) * data.size())) {
+            return;
+        }
+        std::memcpy(data.data(), words, sizeof(Type) * data.size());
+    }
+}
+
+template <typename Type>
+void SLMP::decode_array_label(const Command& command, const std::byte* array_data, std::size_t size,
+                              tcb::span<Type> data) {
+    if constexpr (std::is_same_v<Type, uint8_t>) {
+        // array of booleans, one bit per element
+        if (size < ((data.size() + 7) / 8)) {
+            return;
+        }
+        for (std::size_t i = 0; i < data.size(); i++) {
+            data[i] = (std::to_integer<uint8_t>(array_data[i / 8]) >> (i % 8)) & 0x01;
+        }
+    } else if constexpr (std::is_same_v<Type, std::string>) {
+        const auto string_size = label_string_size(command);
+        if (size < (data.size() * string_size)) {
+            return;
+        }
+        for (std::size_t i = 0; i < data.size(); i++) {
+            const auto string = array_data + i * string_size;
+            data[i].assign(reinterpret_cast<const char*>(string),
+                           static_cast<std::size_t>(std::find(string, string + string_size, std::byte{0}) - string));
+        }
+    } else {
+        if (size < (sizeof(Type) * data.size())) {
+            return;
+        }
+        std::memcpy(data.data(), array_data, sizeof(Type) * data.size());
+    }
+}
+
+template <typename Type>
+void SLMP::encode_array_label(const Command& command, tcb::span<const Type> data, std::vector<std::byte>& array_data) {
+    if constexpr (std::is_same_v<Type, uint8_t>) {
+        // array of booleans, one bit per element
+        array_data.resize(array_data.size() + (data.size() + 15) / 16 * 2);
+        auto bits = &array_data.back() + 1 - (data.size() + 15) / 16 * 2;
+        for (std::size_t i = 0; i < data.size(); i++) {
+            if (data[i]) {
+                bits[i / 8] |= static_cast<std::byte>(0x01 << (i % 8));
+            }
+        }
+    } else if constexpr (std::is_same_v<Type, std::string>) {
+        const auto string_size = label_string_size(command);
+        for (const auto& string : data) {
+            // strings are cut so that at least one `0 byte` is left
+            const auto length = std::min(string.size(), string_size - 1);
+            array_data.resize(array_data.size() + string_size);
+            std::memcpy(&array_data.back() + 1 - string_size, string.data(), length);
+        }
+    } else {
+        array_data.resize(array_data.size() + sizeof(Type) * data.size());
+        std::memcpy(&array_data.back() + 1 - sizeof(Type) * data.size(), data.data(), sizeof(Type) * data.size());
+    }
+}
+
 template <typename Type>
 void SLMP::get(const Command& command, tcb::span<Type> data) {
+    const std::lock_guard<std::recursive_mutex> lock(this->mutex);
     if (command.is_label) {
-        label_array_read_request(command.label, data);
+        // arrays larger than one frame are read in chunks
+        const auto element_size = array_label_element_size<Type>(command);
+        const auto max_elements = max_array_label_elements(command, element_size);
+        for (std::size_t start = 0; start < data.size(); start += max_elements) {
+            const auto chunk = data.subspan(start, std::min(max_elements, data.size() - start));
+            const auto array = array_label(command, start, chunk.size(), element_size);
+            const auto answer = array_label_read_request({&array, 1});
+            std::pair<const std::byte*, std::size_t> array_data;
+            if (answer.has_value() &&
+                split_array_label_data(answer.value().first, answer.value().second, {&array_data, 1})) {
+                decode_array_label(command, array_data.first, array_data.second, chunk);
+            }
+        }
     } else {
-        const auto count = [&]() {
-            if constexpr (std::is_same_v<Type, std::string>) {
-                return data.size() * ((command.length + 1) / 2);
-            } else if constexpr (std::is_same_v<Type, uint8_t>) {
-                // array of booleans
-                return (data.size() + 15) / 16;
+        const auto answer = read_request(command.device, command.device_extension, command.head_no,
+                                         static_cast<uint16_t>(word_count<Type>(command, data.size())));
+        if (answer.has_value()) {
+            decode(command, answer.value().first, answer.value().second, data);
+        }
+    }
+}
+
+template <typename Type>
+bool SLMP::get_many(tcb::span<const Command> commands, tcb::span<Type> data) {
+    assert(commands.size() == data.size() && "every command needs a value");
+    const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    if constexpr (std::is_same_v<Type, bool>) {
+        std::vector<uint16_t> words(commands.size());
+        const auto result = get_many<uint16_t>(commands, words);
+        std::transform(words.begin(), words.end(), data.begin(), [](uint16_t word) { return word != 0; });
+        return result;
+    } else if constexpr (std::is_arithmetic_v<Type> && (sizeof(Type) == 2 || sizeof(Type) == 4)) {
+        // single words and double words are read with random reads
+        constexpr bool double_word = sizeof(Type) == 4;
+        bool result = true;
+        std::size_t start = 0;
+        while (start < commands.size()) {
+            const bool extended = has_device_extension(commands.subspan(start));
+            const auto specification_size = extended ? 13u : 4u;
+            const auto points = std::min({commands.size() - start,
+                                          extended ? max_random_read_extended_points : max_random_read_points,
+                                          max_response_data_size() / sizeof(Type),
+                                          (request_data_size - header_size - 2) / specification_size});
+            const auto chunk = commands.subspan(start, points);
+            const auto answer = double_word ? random_read_request({}, chunk) : random_read_request(chunk, {});
+            if (answer.has_value() && answer.value().second >= points * sizeof(Type)) {
+                std::memcpy(&data[start], answer.value().first, points * sizeof(Type));
             } else {
-                return data.size() * ((sizeof(Type) + 1) / sizeof(uint16_t));
+                result = false;
             }
-        }();
-        const auto answer = read_request(command.device, command.device_extension, command.head_no, count);
-        if (answer.has_value()) {
-            if constexpr (std::is_same_v<Type, uint8_t>) {
-                // array of booleans
-                if (answer.value().second < ((data.size() + 7) / 8)) {
-                    return;
+            start += points;
+        }
+        return result;
+    } else {
+        // everything else is read as blocks of words
+        bool result = true;
+        std::size_t start = 0;
+        while (start < commands.size()) {
+            const bool extended = has_device_extension(commands.subspan(start));
+            const auto specification_size = (extended ? 13u : 4u) + 2u;
+            const auto max_points = std::min(max_block_read_points, max_response_data_size() / sizeof(uint16_t));
+            std::vector<Command> blocks;
+            std::size_t points = 0;
+            for (auto i = start; i < commands.size() && blocks.size() < max_block_read_blocks &&
+                                 header_size + 2 + (blocks.size() + 1) * specification_size <= request_data_size;
+                 i++) {
+                const auto block_points = word_count<Type>(commands[i], 1);
+                if (points + block_points > max_points && !blocks.empty()) {
+                    break;
                 }
-
-                std::size_t index = 0;
-                for (auto& value : data) {
-                    if (index % 8 < 4) {
-                        value = (static_cast<uint8_t>(answer.value().first[index / 8]) & (0x01 << (index % 4))) != 0;
-                    } else {
-                        value = (static_cast<uint8_t>(answer.value().first[index / 8]) & (0x10 << (index % 4))) != 0;
+                blocks.emplace_back(commands[i].device, commands[i].device_extension, commands[i].head_no,
+                                    static_cast<uint16_t>(block_points));
+                points += block_points;
+            }
+            const auto answer = block_read_request(blocks);
+            if (answer.has_value()) {
+                // blocks of word devices are returned first
+                std::size_t offset = 0;
+                for (const bool bit_device : {false, true}) {
+                    for (std::size_t i = 0; i < blocks.size(); i++) {
+                        if (is_bit_device(blocks[i].device) == bit_device) {
+                            const auto size = blocks[i].length * sizeof(uint16_t);
+                            if (offset + size <= answer.value().second) {
+                                decode(commands[start + i], answer.value().first + offset, size,
+                                       data.subspan(start + i, 1));
+                            }
+                            offset += size;
+                        }
                     }
-                    index++;
-                }
-            } else if constexpr (std::is_same_v<Type, std::string>) {
-                if (answer.value().second < (data.size() * command.length)) {
-                    return;
-                }
-                for (std::size_t i = 0; i < data.size(); i++) {
-                    data[i].assign(reinterpret_cast<char*>(answer.value().first + i * command.length), command.length);
                 }
             } else {
-                if (answer.value().second < (sizeof(Type) * data.size())) {
-                    return;
-                }
-                std::memcpy(data.data(), answer.value().first, sizeof(Type) * data.size());
+                result = false;
             }
+            start += blocks.size();
         }
+        return result;
     }
 }
 
 template <>
 inline std::string SLMP::get<std::string>(const Command& command) {
+    const std::lock_guard<std::recursive_mutex> lock(this->mutex);
     if (command.is_label) {
-        std::string data;
-        std::string label_name = command.label;  // :( have to copy label
-        label_read_request<std::string>(tcb::span<std::string>{&label_name, 1}, tcb::span<std::string>{&data, 1});
-        return data;
+        const auto answer = random_label_read_request(1, command.encoded_label);
+        std::pair<const std::byte*, std::size_t> data;
+        if (answer.has_value() && split_label_data(answer.value().first, answer.value().second, {&data, 1})) {
+            return {reinterpret_cast<const char*>(data.first), data.second};
+        }
     } else {
         const auto answer =
             read_request(command.device, command.device_extension, command.head_no, (command.length + 1) / 2);
@@ -641,10 +1363,14 @@ inline bool SLMP::get<bool>(const Command& command) {
 
 template <typename Type>
 Type SLMP::get(const Command& command) {
+    const std::lock_guard<std::recursive_mutex> lock(this->mutex);
     Type value{};
     if (command.is_label) {
-        std::string label_name = command.label;  // :( have to copy label
-        label_read_request<Type>(tcb::span<std::string>{&label_name, 1}, tcb::span<Type>{&value, 1});
+        const auto answer = random_label_read_request(1, command.encoded_label);
+        std::pair<const std::byte*, std::size_t> data;
+        if (answer.has_value() && split_label_data(answer.value().first, answer.value().second, {&data, 1})) {
+            std::memcpy(&value, data.first, std::min(sizeof(Type), data.second));
+        }
     } else {
         const auto data = read_request(command.device, command.device_extension, command.head_no,
                                        (sizeof(Type) + 1) / sizeof(uint16_t));
@@ -681,4 +1407,26 @@ bool SLMP::write(const Command& command, Type value) {
                                                                        command.head_no, tcb::span<Type>{&value, 1});
         return answer.has_value();
     }
+}
+
+template <typename Type>
+bool SLMP::write(const Command& command, tcb::span<const Type> data) {
+    if (!command.is_label) {
+        return false;
+    }
+    const std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    // arrays larger than one frame are written in chunks
+    const auto element_size = array_label_element_size<Type>(command);
+    const auto max_elements = max_array_label_elements(command, element_size);
+    std::vector<std::byte> array_data;
+    for (std::size_t start = 0; start < data.size(); start += max_elements) {
+        const auto chunk = data.subspan(start, std::min(max_elements, data.size() - start));
+        const auto array = array_label(command, start, chunk.size(), element_size);
+        array_data.clear();
+        encode_array_label(command, chunk, array_data);
+        if (!array_label_write_request({&array, 1}, {&array_data, 1})) {
+            return false;
+        }
+    }
+    return true;
 }
\ No newline at end of file
@@ -7,11 +7,16 @@
 #include <ws2tcpip.h>
 #else
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
+
+#include <cerrno>
 #endif
 
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <mutex>
 #include <optional>
@@ -21,6 +26,15 @@
 
 class SocketException : ::std::exception {};
 
+// progress of a response that is received piecewise as its data arrives, without waiting for the rest
+enum class Receive { Waiting, Complete, Failed };
+
+#ifdef WIN32
+using SocketHandle = SOCKET;
+#else
+using SocketHandle = int;
+#endif
+
 class Socket {
    public:
     Socket(Socket const&) = delete;
@@ -43,7 +57,11 @@ class Socket {
 #endif
     }
 
-    std::optional<int> connect(int timeout_ms = 0) {
+    // connects blocking for at most connect_timeout_ms, afterwards a send or receive waits at most request_timeout_ms
+    // (0 waits forever)
+    std::optional<int> connect(int connect_timeout_ms = 0, int request_timeout_ms = 0) {
+        // a reconnect replaces the previous connection
+        close();
 #ifdef WIN32
         ::WSADATA wsadata;
         auto iresult = WSAStartup(MAKEWORD(2, 2), &wsadata);
@@ -63,44 +81,118 @@ class Socket {
             return {};
         }
 
-        iresult = ::setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout_ms),
-                               sizeof(timeout_ms));
-
-        if (iresult == SOCKET_ERROR) {
+        if (!set_timeouts(connect_timeout_ms)) {
             return {};
         }
 
         iresult = ::connect(socket, localinfo->ai_addr, static_cast<int>(localinfo->ai_addrlen));
 
-        if (iresult == SOCKET_ERROR) {
+        if (iresult == SOCKET_ERROR || !set_timeouts(request_timeout_ms)) {
             return {};
         }
         return iresult;
 #else
         this->socket = ::socket(AF_INET, SOCK_STREAM, 0);
 
-        struct timeval timeval {};
-        timeval.tv_sec = 0;
-        timeval.tv_usec = timeout_ms * 1000;
-        int retVal = ::setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeval, sizeof(timeval));
-        if (retVal < 0) {
+        // a send timeout also limits a blocking connect
+        if (!set_timeouts(connect_timeout_ms)) {
             return {};
         }
-        retVal = ::connect(socket, reinterpret_cast<struct sockaddr*>(&servinfo), addr_len);
-        if (retVal == -1) {
+        const int retVal = ::connect(socket, reinterpret_cast<struct sockaddr*>(&servinfo), addr_len);
+        if (retVal == -1 || !set_timeouts(request_timeout_ms)) {
             return {};
         }
         return retVal;
 #endif
     }
 
+    // starts connecting without waiting for the connection, the returned socket becomes writable once the connect
+    // completed or failed, which is checked with finish_connect
+    std::optional<SocketHandle> connect_async() {
+        close();
+#ifdef WIN32
+        ::WSADATA wsadata;
+        if (WSAStartup(MAKEWORD(2, 2), &wsadata) != 0) {
+            return {};
+        }
+        if (::getaddrinfo(addr, std::to_string(port).data(), &servinfo, &localinfo) != 0) {
+            return {};
+        }
+        socket = ::socket(localinfo->ai_family, localinfo->ai_socktype, localinfo->ai_protocol);
+        if (socket == INVALID_SOCKET) {
+            socket = 0;
+            return {};
+        }
+        u_long non_blocking = 1;
+        if (::ioctlsocket(socket, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+            return {};
+        }
+        if (::connect(socket, localinfo->ai_addr, static_cast<int>(localinfo->ai_addrlen)) == SOCKET_ERROR &&
+            WSAGetLastError() != WSAEWOULDBLOCK) {
+            return {};
+        }
+#else
+        socket = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (socket == -1) {
+            socket = 0;
+            return {};
+        }
+        const int flags = ::fcntl(socket, F_GETFL, 0);
+        if (flags == -1 || ::fcntl(socket, F_SETFL, flags | O_NONBLOCK) == -1) {
+            return {};
+        }
+        if (::connect(socket, reinterpret_cast<struct sockaddr*>(&servinfo), addr_len) == -1 && errno != EINPROGRESS) {
+            return {};
+        }
+#endif
+        return socket;
+    }
+
+    // checks the connect started with connect_async once the socket is writable and switches the socket back to
+    // blocking sends and receives, a send or receive waits at most request_timeout_ms (0 waits forever). returns false
+    // if the connect failed
+    bool finish_connect(int request_timeout_ms) {
+        int error = 0;
+#ifdef WIN32
+        int length = sizeof(error);
+        if (::getsockopt(socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) == SOCKET_ERROR ||
+            error != 0) {
+            return false;
+        }
+        u_long non_blocking = 0;
+        if (::ioctlsocket(socket, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+            return false;
+        }
+#else
+        socklen_t length = sizeof(error);
+        if (::getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0) {
+            return false;
+        }
+        const int flags = ::fcntl(socket, F_GETFL, 0);
+        if (flags == -1 || ::fcntl(socket, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+            return false;
+        }
+#endif
+        return set_timeouts(request_timeout_ms);
+    }
+
     ~Socket() {
+        close();
 #ifdef WIN32
-        ::closesocket(socket);
         WSACleanup();
+#endif
+    }
+
+    void close() {
+        if (socket == 0) {
+            return;
+        }
+#ifdef WIN32
+        ::closesocket(socket);
 #else
         ::close(socket);
 #endif
+        socket = 0;
     }
 
     std::optional<int> send(const void* sendData, const ::size_t& size) {
@@ -128,14 +220,75 @@ class Socket {
             return {};
         }
 #endif
-        static_cast<char*>(recvData)[numbytes] = 0;
-        return numbytes;
+        return static_cast<int>(numbytes);
+    }
+
+    // receives the data that already arrived without waiting for more, returns 0 if nothing arrived yet and nothing if
+    // the connection failed or was closed by the device
+    std::optional<int> recv_available(void* recvData, const ::size_t& size) {
+        if (!readable(0)) {
+            return 0;
+        }
+        const auto recv_result = recv(recvData, size);
+        if (!recv_result.has_value() || recv_result.value() == 0) {
+            return {};
+        }
+        return recv_result;
+    }
+
+    // waits at most timeout_ms for data to receive, 0 only checks if data already arrived and -1 waits forever
+    bool readable(int timeout_ms) {
+#ifdef WIN32
+        ::WSAPOLLFD descriptor{socket, POLLRDNORM, 0};
+        return ::WSAPoll(&descriptor, 1, static_cast<INT>(timeout_ms)) > 0;
+#else
+        ::pollfd descriptor{socket, POLLIN, 0};
+        return ::poll(&descriptor, 1, timeout_ms) > 0;
+#endif
+    }
+
+    // waits for data to receive at most until deadline, without a deadline it waits forever
+    bool readable_until(std::optional<std::chrono::steady_clock::time_point> deadline) {
+        if (!deadline.has_value()) {
+            return readable(-1);
+        }
+        const auto remaining =
+            std::chrono::ceil<std::chrono::milliseconds>(deadline.value() - std::chrono::steady_clock::now()).count();
+        return remaining > 0 && readable(static_cast<int>(remaining));
+    }
+
+    // the socket that a reactor waits on for data to receive
+    SocketHandle handle() const {
+        return socket;
+    }
+
+    // deadline of a request that may take at most timeout_ms, nothing for 0, which waits forever
+    static std::optional<std::chrono::steady_clock::time_point> deadline(int timeout_ms) {
+        if (timeout_ms == 0) {
+            return {};
+        }
+        return std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
     }
 
     const char* addr;
     int port;
 
    private:
+    // limits how long a blocking send or receive waits
+    bool set_timeouts(int timeout_ms) {
+#ifdef WIN32
+        const auto value = reinterpret_cast<const char*>(&timeout_ms);
+        return ::setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, value, sizeof(timeout_ms)) != SOCKET_ERROR &&
+               ::setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, value, sizeof(timeout_ms)) != SOCKET_ERROR;
+#else
+        struct timeval timeval {};
+        timeval.tv_sec = timeout_ms / 1000;
+        timeval.tv_usec = (timeout_ms % 1000) * 1000;
+        return ::setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeval, sizeof(timeval)) == 0 &&
+               ::setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeval, sizeof(timeval)) == 0;
+#endif
+    }
+
 #ifdef WIN32
     SOCKET socket;
     addrinfo servinfo{};
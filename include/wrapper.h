@@ -6,9 +6,21 @@
 #include <open62541/types.h>
 #include <open62541/types_generated.h>
 
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <optional>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "reactor.h"
+#include "shadow.h"
 
 #define CHECK(func, message)                                                                 \
     do {                                                                                     \
@@ -27,6 +39,20 @@ static std::mutex access_ua_server_mutex;
 
 struct Client {
     std::string name;
+    ShadowStore shadow;
+    std::chrono::milliseconds poll_interval{500};
+    // reactor that runs the device, nullptr if the device is run by the caller, e.g. in a benchmark
+    Reactor* reactor = nullptr;
+    // all device i/o after the connect, i.e. the poll cycles and the reads and writes of the opc ua callbacks, runs on
+    // this queue, so that a read or write isn't sent in between the requests of a poll cycle
+    DeviceQueue io;
+    // a read on a shadow miss is answered right away instead of waiting for the queued read, set with AsyncIO
+    bool async_io = false;
+    // a read of the nodes without a shadow value is queued in io and didn't start yet
+    std::atomic<bool> missing_read_queued{false};
+    // held shared by the callbacks and queued reads while they use the nodes of the device, and exclusively while the
+    // node index and the polled nodes are replaced, as the nodes are created and deleted on a worker of the reactor
+    std::shared_mutex nodes_mutex;
     virtual ~Client() = default;
 
     virtual bool connected() {
@@ -34,6 +60,42 @@ struct Client {
     }
 };
 
+// collects all nodes that are backed by a device value, i.e. all nodes with a read command
+template <typename Node>
+void collect_polled_nodes(const Node& node, std::vector<const Node*>& nodes) {
+    for (const auto& child_node : node.children) {
+        if (child_node.read_command.has_value()) {
+            nodes.push_back(&child_node);
+        }
+        collect_polled_nodes(child_node, nodes);
+    }
+}
+
+// indexes all nodes below node by their numeric node id, so that the data source callbacks of a device find their node
+// without searching the node tree. only built once the node tree is complete, as the pointers are stable from then on
+template <typename Node>
+void index_nodes(const Node& node, std::unordered_map<UA_UInt32, const Node*>& nodes) {
+    for (const auto& child_node : node.children) {
+        if (child_node.node.identifierType == UA_NODEIDTYPE_NUMERIC) {
+            nodes.emplace(child_node.node.identifier.numeric, &child_node);
+        }
+        index_nodes(child_node, nodes);
+    }
+}
+
+// returns the indexed node with node_id, nullptr if it isn't a node of the device
+template <typename Node>
+const Node* find_node(const std::unordered_map<UA_UInt32, const Node*>& nodes, const UA_NodeId& node_id) {
+    if (node_id.identifierType != UA_NODEIDTYPE_NUMERIC) {
+        return nullptr;
+    }
+    const auto it = nodes.find(node_id.identifier.numeric);
+    if (it == nodes.end() || it->second->node.namespaceIndex != node_id.namespaceIndex) {
+        return nullptr;
+    }
+    return it->second;
+}
+
 template <typename Type>
 struct Datatype {
     Type value;
@@ -190,6 +252,28 @@ inline UA_NodeId addObjectNode(UA_Server* server, char* name, std::optional<UA_N
     return out_node_id;
 }
 
+// returns the specification in file_name compiled with compile. the compiled specification is shared by all devices
+// and only compiled again once the file changed, devices that are still creating nodes keep the previous one
+template <typename Compile>
+auto load_specification(const std::string& file_name, Compile compile)
+    -> std::shared_ptr<const decltype(compile(std::declval<const nlohmann::json&>()))> {
+    using Specification = decltype(compile(std::declval<const nlohmann::json&>()));
+    static std::mutex mutex;
+    static std::shared_ptr<const Specification> specification;
+    static std::filesystem::file_time_type last_write_time;
+
+    std::scoped_lock<std::mutex> guard(mutex);
+    std::error_code error;
+    const auto write_time = std::filesystem::last_write_time(file_name, error);
+    if (specification == nullptr || error || write_time != last_write_time) {
+        std::ifstream specs(file_name);
+        specification = std::make_shared<const Specification>(
+            compile(nlohmann::json::parse(specs, nullptr, true, true)));
+        last_write_time = write_time;
+    }
+    return specification;
+}
+
 inline UA_StatusCode delete_node(UA_Server* server, const UA_NodeId nodeId, UA_Boolean deleteReferences) {
     std::scoped_lock<std::mutex> guard(access_ua_server_mutex);
 
@@ -49,6 +49,7 @@ static UA_Logger file_logger{log, nullptr, nullptr};
 #endif
 
 #include "plc.h"
+#include "reactor.h"
 #include "robot.h"
 #include "wrapper.h"
 
@@ -103,14 +104,14 @@ class Clients : public efsw::FileWatchListener {
           filewatcher{},
           watchid{-1},
           clients{},
-          threads{},
+          reactor{std::max(4u, std::thread::hardware_concurrency())},
           last_change_event{} {}
 
     virtual ~Clients() {
         if (watchid != -1) {
             filewatcher.removeWatch(watchid);
         }
-        threads.resize(0);
+        reactor.cancel_all();
         UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Shutdown client threads");
     }
 
@@ -139,14 +140,30 @@ class Clients : public efsw::FileWatchListener {
             std::scoped_lock<std::mutex> guard(change_event_mutex);
             send_msg_to_gui("{\"clear_devices\": {}}", false);
             restart_clients = true;
-            if (threads.size() > 0) {
+            if (clients.size() > 0) {
                 UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Restarting devices");
-                for (const auto& thread : threads) {
-                    thread.wait();
+                // callbacks that arrive until their nodes are deleted run their device i/o on the server thread, so
+                // nothing is queued for a device anymore once the reactor is cancelled
+                for (const auto& client : clients) {
+                    client->io.attach(nullptr);
+                }
+                reactor.cancel_all();
+                for (const auto& client : clients) {
+                    client->io.cancel();
                 }
                 UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Threads finished");
+                if (running) {
+                    // the devices are removed or the clients are restarted, no callback reaches a device once its
+                    // nodes are deleted
+                    for (const auto& client : clients) {
+                        if (const auto robot = dynamic_cast<Robot*>(client.get())) {
+                            delete_robot_node(robot, server);
+                        } else if (const auto plc = dynamic_cast<PLC*>(client.get())) {
+                            delete_plc_node(plc, server);
+                        }
+                    }
+                }
             }
-            threads.resize(0);
             clients.resize(0);
             restart_clients = false;
 
@@ -157,18 +174,35 @@ class Clients : public efsw::FileWatchListener {
             UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Found %zu client(s)", client_nodes["Clients"].size());
 
             clients.reserve(client_nodes["Clients"].size());
-            threads.reserve(client_nodes["Clients"].size());
 
             for (const auto& client_node : client_nodes["Clients"]) {
                 if (client_node["Type"] == "Robot") {
                     clients.push_back(std::make_unique<Robot>(client_node["Name"].get<std::string>(),
                                                               client_node["Ip"].get<std::string>(),
                                                               client_node["Port"].get<int>()));
-                    threads.push_back(std::async(std::launch::async, &Clients::run_robot, this,
-                                                 dynamic_cast<Robot*>(clients.back().get())));
-                    UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Created robot %s (%s:%d)",
-                                client_node["Name"].get<std::string>().data(),
-                                client_node["Ip"].get<std::string>().data(), client_node["Port"].get<int>());
+                    if (client_node.contains("MaxPendingCommands")) {
+                        // max number of commands that are sent ahead of their answers
+                        dynamic_cast<Robot*>(clients.back().get())->r3.max_pending_commands =
+                            client_node["MaxPendingCommands"].get<std::size_t>();
+                    }
+                    if (client_node.contains("Terminator") && client_node["Terminator"].get<std::string>() == "CR") {
+                        // commands and answers end with a carriage return, needed to send commands ahead of answers
+                        dynamic_cast<Robot*>(clients.back().get())->r3.terminator = '\r';
+                    }
+                    if (client_node.contains("ConnectTimeout")) {
+                        dynamic_cast<Robot*>(clients.back().get())->r3.connect_timeout_ms =
+                            client_node["ConnectTimeout"].get<int>();
+                    }
+                    if (client_node.contains("RequestTimeout")) {
+                        // max time in ms a worker waits for an answer of the robot
+                        dynamic_cast<Robot*>(clients.back().get())->r3.request_timeout_ms =
+                            client_node["RequestTimeout"].get<int>();
+                    }
+                    if (client_node.contains("CacheStructure")) {
+                        // the discovered structure of the robot is stored on disk and reused after a reconnect
+                        dynamic_cast<Robot*>(clients.back().get())->cache_structure =
+                            client_node["CacheStructure"].get<bool>();
+                    }
                 } else if (client_node["Type"] == "PLC") {
                     clients.push_back(std::make_unique<PLC>(
                         client_node["Name"].get<std::string>(), client_node["Ip"].get<std::string>(),
@@ -176,15 +210,76 @@ class Clients : public efsw::FileWatchListener {
                         client_node["Destination station No."].get<uint8_t>(),
                         client_node["Destination Module I/O"].get<uint16_t>(),
                         client_node["Destination multidrop station No."].get<uint8_t>()));
-                    threads.push_back(std::async(std::launch::async, &Clients::run_plc, this,
-                                                 dynamic_cast<PLC*>(clients.back().get())));
-                    UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Created plc %s (%s:%d)",
-                                client_node["Name"].get<std::string>().data(),
-                                client_node["Ip"].get<std::string>().data(), client_node["Port"].get<int>());
+                    auto plc = dynamic_cast<PLC*>(clients.back().get());
+                    if (client_node.contains("CoalesceGap")) {
+                        // max number of unread words between two device nodes that are read with one request
+                        plc->coalesce_gap = client_node["CoalesceGap"].get<std::size_t>();
+                    }
+                    if (client_node.contains("Monitor")) {
+                        // the polled devices are registered with the plc and read with one monitor request
+                        plc->monitor = client_node["Monitor"].get<bool>();
+                    }
+                    if (client_node.contains("Connections")) {
+                        // additional ports of the plc, the requests of a poll cycle are spread over all connections
+                        for (const auto& port : client_node["Connections"]) {
+                            plc->connections.push_back(std::make_unique<SLMP>(
+                                client_node["Ip"].get<std::string>(), port.get<int>(),
+                                client_node["Destination network No."].get<uint8_t>(),
+                                client_node["Destination station No."].get<uint8_t>(),
+                                client_node["Destination Module I/O"].get<uint16_t>(),
+                                client_node["Destination multidrop station No."].get<uint8_t>()));
+                        }
+                    }
+                    std::vector<SLMP*> slmps{&plc->slmp};
+                    for (const auto& connection : plc->connections) {
+                        slmps.push_back(connection.get());
+                    }
+                    for (const auto slmp : slmps) {
+                        if (client_node.contains("Frame") && client_node["Frame"].get<std::string>() == "4E") {
+                            // 4E frames carry serial numbers, so that the requests of a poll cycle can be pipelined
+                            slmp->set_frame(SLMP::Frame::E4);
+                        }
+                        if (client_node.contains("MaxPendingRequests")) {
+                            slmp->max_pending_requests = client_node["MaxPendingRequests"].get<std::size_t>();
+                        }
+                        if (client_node.contains("ConnectTimeout")) {
+                            slmp->connect_timeout_ms = client_node["ConnectTimeout"].get<int>();
+                        }
+                        if (client_node.contains("RequestTimeout")) {
+                            // max time in ms a worker waits for a response of the plc
+                            slmp->request_timeout_ms = client_node["RequestTimeout"].get<int>();
+                        }
+                    }
                 } else {
                     UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Invalid device type %s of device %s",
                                 client_node["Type"].get<std::string>().data(),
                                 client_node["Name"].get<std::string>().data());
+                    continue;
+                }
+                if (client_node.contains("PollInterval")) {
+                    // cycle in ms in which the node values of the device are refreshed
+                    clients.back()->poll_interval = std::chrono::milliseconds(client_node["PollInterval"].get<int>());
+                }
+                clients.back()->reactor = &reactor;
+                clients.back()->io.attach(&reactor);
+                if (client_node.contains("AsyncIO")) {
+                    // reads on a shadow miss don't wait on the device
+                    clients.back()->async_io = client_node["AsyncIO"].get<bool>();
+                }
+
+                // options have to be set before the device is started
+                if (client_node["Type"] == "Robot") {
+                    const auto robot = dynamic_cast<Robot*>(clients.back().get());
+                    reactor.post([this, robot] { run_device(robot, [&] { connect_device(robot); }); });
+                    UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Created robot %s (%s:%d)",
+                                client_node["Name"].get<std::string>().data(),
+                                client_node["Ip"].get<std::string>().data(), client_node["Port"].get<int>());
+                } else {
+                    const auto plc = dynamic_cast<PLC*>(clients.back().get());
+                    reactor.post([this, plc] { run_device(plc, [&] { connect_device(plc); }); });
+                    UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_USERLAND, "Created plc %s (%s:%d)",
+                                client_node["Name"].get<std::string>().data(),
+                                client_node["Ip"].get<std::string>().data(), client_node["Port"].get<int>());
                 }
             }
         } catch (std::exception& e) {
@@ -193,82 +288,148 @@ class Clients : public efsw::FileWatchListener {
         }
     }
 
-    void run_robot(Robot* robot) {
-        try {
-            while (running && !restart_clients) {
-                robot->r3.connect();
-                if (robot->r3.connected) {
-                    std::cout << "Hallo from " << robot->name << "\n";
-                    create_robot_node(robot, server, client_file.c_str());
-
-                    send_update_to_gui(robot->name, true);
+    static R3& connection(Robot* robot) {
+        return robot->r3;
+    }
 
-                    while (robot->r3.connected && running && !restart_clients) {
-                        std::this_thread::sleep_for(std::chrono::seconds(1));
-                    }
-                    if (running) {
-                        delete_node(server, robot->node.node, true);
-                    }
-                }
+    static SLMP& connection(PLC* plc) {
+        return plc->slmp;
+    }
 
-                send_update_to_gui(robot->name, false);
+    // creates or keeps the nodes of a device that just connected
+    void setup_device(Robot* robot) {
+        std::cout << "Hallo from " << robot->name << "\n";
+        update_robot_node(robot, server, client_file.c_str());
+    }
 
-                if (running && !restart_clients) {
-                    std::this_thread::sleep_for(std::chrono::seconds(3));
-                }
+    void setup_device(PLC* plc) {
+        for (const auto& connection : plc->connections) {
+            if (!connection->connected) {
+                connection->connect();
             }
+        }
+        update_plc_node(plc, server, client_file.c_str());
+    }
+
+    template <typename Finished>
+    static void poll_device(Robot* robot, Finished finished) {
+        poll_robot_async(robot, finished);
+    }
+
+    template <typename Finished>
+    static void poll_device(PLC* plc, Finished finished) {
+        poll_plc_async(plc, finished);
+    }
+
+    void delete_device_node(Robot* robot) {
+        delete_robot_node(robot, server);
+    }
+
+    void delete_device_node(PLC* plc) {
+        delete_plc_node(plc, server);
+    }
+
+    // runs work of device on a worker of the reactor, a device whose work throws is stopped
+    template <typename Device, typename Work>
+    void run_device(Device* device, Work work) {
+        try {
+            work();
+            return;
         } catch (const std::exception& e) {
             UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_CLIENT, "running device '%s' threw exception %s",
-                        robot->name.c_str(), e.what());
+                        device->name.c_str(), e.what());
         } catch (const std::string& e) {
             UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_CLIENT, "running device '%s' threw exception %s",
-                        robot->name.c_str(), e.c_str());
+                        device->name.c_str(), e.c_str());
         } catch (...) {
             UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_CLIENT, "running device '%s' threw exception",
-                        robot->name.c_str());
+                        device->name.c_str());
+        }
+        if (running) {
+            // the device is stopped until the clients are restarted
+            delete_device_node(device);
         }
     }
 
-    void run_plc(PLC* plc) {
-        try {
-            while (running && !restart_clients) {
-                plc->slmp.connect();
-                if (plc->slmp.connected) {
-                    create_plc_node(plc, server, client_file.c_str());
-
-                    send_update_to_gui(plc->name, true);
+    // starts connecting the device, no worker waits for the connection. the reactor hands the connection back to a
+    // worker once it is established or the connect timed out
+    template <typename Device>
+    void connect_device(Device* device) {
+        if (!running || restart_clients) {
+            return;
+        }
+        const auto socket = connection(device).connect_async();
+        if (!socket.has_value()) {
+            reconnect_device(device);
+            return;
+        }
+        const auto connect_timeout = std::chrono::milliseconds(connection(device).connect_timeout_ms);
+        reactor.when_writable(socket.value(), connect_timeout, [this, device](bool writable) {
+            run_device(device, [&] {
+                connection(device).finish_connect(writable);
+                if (!connection(device).connected) {
+                    reconnect_device(device);
+                    return;
+                }
+                setup_device(device);
+                send_update_to_gui(device->name, true);
+                poll_device_cycle(device);
+            });
+        });
+    }
 
-                    while (plc->slmp.connected && running && !restart_clients) {
-                        std::this_thread::sleep_for(std::chrono::seconds(1));
-                    }
-                    if (running) {
-                        delete_node(server, plc->node.node, true);
-                    }
+    // polls the device on its queue and schedules its next poll cycle, as long as it stays connected. the reactor waits
+    // for the responses of the device, so a poll cycle only occupies a worker while it sends requests and decodes
+    // responses
+    template <typename Device>
+    void poll_device_cycle(Device* device) {
+        if (!running || restart_clients) {
+            return;
+        }
+        const auto next_cycle = Reactor::Clock::now() + device->poll_interval;
+        device->io.push_async([this, device, next_cycle](Reactor::Task done) {
+            run_device(device, [&] {
+                if (!connection(device).connected) {
+                    done();
+                    finish_poll_cycle(device, next_cycle);
+                    return;
                 }
+                poll_device(device, [this, device, next_cycle, done] {
+                    done();
+                    run_device(device, [&] { finish_poll_cycle(device, next_cycle); });
+                });
+            });
+        });
+    }
 
-                send_update_to_gui(plc->name, false);
+    template <typename Device>
+    void finish_poll_cycle(Device* device, Reactor::Clock::time_point next_cycle) {
+        if (connection(device).connected) {
+            reactor.schedule(next_cycle, [this, device] { run_device(device, [&] { poll_device_cycle(device); }); });
+            return;
+        }
+        // the nodes are kept until the device is connected again, with their last values
+        device->shadow.mark_stale();
+        reconnect_device(device);
+    }
 
-                if (running && !restart_clients) {
-                    std::this_thread::sleep_for(std::chrono::seconds(3));
-                }
-            }
-        } catch (const std::exception& e) {
-            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_CLIENT, "running device '%s' threw exception %s",
-                        plc->name.c_str(), e.what());
-        } catch (const std::string& e) {
-            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_CLIENT, "running device '%s' threw exception %s",
-                        plc->name.c_str(), e.c_str());
-        } catch (...) {
-            UA_LOG_INFO(&file_logger, UA_LOGCATEGORY_CLIENT, "running device '%s' threw exception", plc->name.c_str());
+    template <typename Device>
+    void reconnect_device(Device* device) {
+        send_update_to_gui(device->name, false);
+        if (running && !restart_clients) {
+            reactor.schedule(Reactor::Clock::now() + std::chrono::seconds(3),
+                             [this, device] { run_device(device, [&] { connect_device(device); }); });
         }
     }
+
     std::string client_file;
     std::string client_file_directory;
     UA_Server* server;
     efsw::FileWatcher filewatcher;
     efsw::WatchID watchid;
     std::vector<std::unique_ptr<Client>> clients;
-    std::vector<std::future<void>> threads;
+    // runs all devices, declared after clients so that it is stopped before the devices are destroyed
+    Reactor reactor;
     std::mutex change_event_mutex;
     std::chrono::time_point<std::chrono::system_clock> last_change_event;
 
@@ -0,0 +1,33 @@
+#pragma once
+
+// counts every heap allocation of the process by replacing malloc, operator new and open62541 both allocate with
+// malloc. replacing malloc needs glibc, and the header defines the replacements, so it is included by exactly one
+// translation unit of a test
+#include <atomic>
+#include <cstddef>
+
+extern "C" void* __libc_malloc(std::size_t size);
+extern "C" void* __libc_calloc(std::size_t count, std::size_t size);
+extern "C" void* __libc_realloc(void* pointer, std::size_t size);
+extern "C" void __libc_free(void* pointer);
+
+static std::atomic<std::size_t> allocations{0};
+
+extern "C" void* malloc(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(std::size_t count, std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer) {
+    __libc_free(pointer);
+}
\ No newline at end of file
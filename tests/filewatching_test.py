@@ -18,8 +18,12 @@ namespace = "urn:open62541.server.application"
 
 @pytest.fixture(autouse=True)
 def server():
-    # create clients.json
-    shutil.copy("tests/test_clients.json", "tests/clients.json")
+    # create clients.json with the first plc and robot, the clients are changed relative to them
+    with open("tests/test_clients.json", encoding="utf-8", mode="r") as file:
+        clients = json.loads("".join(re.sub("(.*?)(//.*)?", "\\1", row) for row in file))
+        clients["Clients"] = clients["Clients"][:2]
+    with open("tests/clients.json", encoding="utf-8", mode="w") as file:
+        file.write(json.dumps(clients, indent=4))
 
     # create server.json
     shutil.copy("tests/test_server.json", "tests/server.json")
@@ -2,6 +2,8 @@ from enum import Enum
 import math
 import struct
 import socket
+import sys
+import threading
 import traceback
 from typing import Any, Dict, Iterable, List, Optional, Tuple, Union
 
@@ -81,6 +83,7 @@ def pairwise(iterable: Iterable[Any]) -> Iterable[Any]:
 FIRMWARE_VERSION = 0xACF3
 OPERATING_STATUS = 0x03
 PRODUCTION_INFORMATION = "123456789ABCDEFG"
+STRING_LABEL_SIZE = 34  # string(32) labels with 1 or 2 `0 bytes`
 M_DEVICE = "M-Device", [1, 65535, 2, 65535], DatatypeId.Word, False, 96
 M_BOOL_DEVICE = "M-Bool-Device", True, DatatypeId.Bool, True, 165
 M_BOOL_ARRAY_DEVICE = "M-Bool-Array-Device", [False, True, False, True, False], DatatypeId.Bool, False, 195
@@ -106,7 +109,7 @@ B_ARRAY_LABEL = "bArrayLabel", [False, True, False, True], DatatypeId.Bool, Fals
 E_LABEL = "eLabel", 5.0, DatatypeId.Double, True
 S_LABEL = "sLabel", b"Hallo", DatatypeId.String, True
 S_ARRAY_LABEL = "sArrayLabel", [b"Hallo", b"Hallo2", b"Hallo3"], DatatypeId.String, False
-U_LABEL = "uLabel", [1, 3, 5, 7], DatatypeId.Word, False
+U_LABEL = "uLabel", [1, 3, 5, 7], DatatypeId.Word, True
 WD_LABEL = "wdLabel", -31012121, DatatypeId.DInt, True
 UD_LABEL = "udLabel", 31012121, DatatypeId.DoubleWord, True
 
@@ -261,19 +264,19 @@ def get_values(
     if device[1] == DeviceType.Word:
         if extension_specification != -1 and extension_type == 0xF8:
             # module access device
-            return [devices[f"U{extension_specification:03X}"][head_device_no + key] for key in range(no_of_devices)]
+            return [devices[f"U{extension_specification:03X}"].get(head_device_no + key, 0) for key in range(no_of_devices)]
         elif extension_specification != -1 and extension_type == 0xFA:
             # cpu buffer memory access device
-            return [devices[ExtensionSpecification(extension_specification).name][head_device_no + key] for key in range(no_of_devices)]
+            return [devices[ExtensionSpecification(extension_specification).name].get(head_device_no + key, 0) for key in range(no_of_devices)]
         else:
-            # regular device access
-            return [devices[device[0]][head_device_no + key] for key in range(no_of_devices)]
+            # regular device access, unused devices read as 0 like on a real plc
+            return [devices[device[0]].get(head_device_no + key, 0) for key in range(no_of_devices)]
     elif device[1] == DeviceType.Bit:
         values: List[int] = []
         for device_no in {math.floor((head_device_no + i) / 16) * 16 for i in range(no_of_devices)}:
             start = (head_device_no % 16) if device_no == math.floor((head_device_no) / 16) * 16 else 0
             end = ((head_device_no + no_of_devices) % 16) if device_no == math.floor((head_device_no + no_of_devices) / 16) * 16 else 16
-            values.extend(int(bit) for i, bit in enumerate(f"{devices[device[0]][device_no]:016b}"[::-1]) if i >= start and i < end)
+            values.extend(int(bit) for i, bit in enumerate(f"{devices[device[0]].get(device_no, 0):016b}"[::-1]) if i >= start and i < end)
         return values
     return []
 
@@ -411,6 +414,165 @@ def read_request(command: int, subcommand: int, serial_number: List[int], data:
         return error_response(serial_number, Endcode.WrongCommand)
 
 
+def parse_device_specification(subcommand: int, data: bytes, start: int) -> Tuple[Tuple[str, DeviceType], int, int, int, int]:
+    # returns device, head device no, extension specification, extension type and the start of the next specification
+    if subcommand == 0x0082:
+        device = device_map[struct.unpack("H", data[(start + 6) : (start + 8)])[0]]
+        head_device_no = struct.unpack("I", data[(start + 2) : (start + 6)])[0]
+        extension_type = struct.unpack("B", data[(start + 12) : (start + 13)])[0]
+        extension_specification = struct.unpack("H", data[(start + 10) : (start + 12)])[0] if extension_type != 0x00 else -1
+        return device, head_device_no, extension_specification, extension_type if extension_type != 0x00 else -1, start + 13
+    device = device_map[struct.unpack("B", data[(start + 3) : (start + 4)])[0]]
+    head_device_no = struct.unpack("I", data[start : (start + 3)] + b"\x00")[0]
+    return device, head_device_no, -1, -1, start + 4
+
+
+def get_words(
+    device: Tuple[str, DeviceType], head_device_no: int, no_of_words: int, extension_specification: int = -1, extension_type: int = -1
+) -> List[int]:
+    if device[1] == DeviceType.Bit:
+        # bit device in word units
+        return [combine_bits(get_values(device, head_device_no + 16 * i, 16), DeviceType.Word) for i in range(no_of_words)]
+    return get_values(device, head_device_no, no_of_words, extension_specification, extension_type)
+
+
+RandomDevice = Tuple[Tuple[str, DeviceType], int, int, int, int]
+
+
+def parse_random_devices(subcommand: int, data: bytes) -> List[RandomDevice]:
+    # returns device, head device no, number of words, extension specification and extension type of every point
+    word_points, double_word_points = struct.unpack("BB", data[:2])
+    start = 2
+    devices: List[RandomDevice] = []
+    for i in range(word_points + double_word_points):
+        device, head_device_no, extension_specification, extension_type, start = parse_device_specification(subcommand, data, start)
+        devices.append((device, head_device_no, 2 if i >= word_points else 1, extension_specification, extension_type))
+    return devices
+
+
+def random_read_request(subcommand: int, serial_number: List[int], data: bytes) -> bytes:
+    if subcommand != 0x0000 and subcommand != 0x0082:
+        return error_response(serial_number, Endcode.WrongCommand)
+    try:
+        values: List[int] = []
+        for device, head_device_no, no_of_words, extension_specification, extension_type in parse_random_devices(subcommand, data):
+            print(f"Random read: {device}, {head_device_no}, {no_of_words}")
+            values.extend(get_words(device, head_device_no, no_of_words, extension_specification, extension_type))
+    except (IndexError, KeyError, struct.error):
+        return error_response(serial_number, Endcode.InvalidDevice)
+    return read_response(serial_number, values)
+
+
+def monitor_registration_request(subcommand: int, serial_number: List[int], data: bytes, registration: List[RandomDevice]) -> bytes:
+    # the registration is kept for the connection it was sent on
+    if subcommand != 0x0000 and subcommand != 0x0082:
+        return error_response(serial_number, Endcode.WrongCommand)
+    try:
+        devices = parse_random_devices(subcommand, data)
+    except (IndexError, KeyError, struct.error):
+        return error_response(serial_number, Endcode.InvalidDevice)
+    print(f"Monitor registration: {len(devices)} points")
+    registration[:] = devices
+    return success_response(serial_number)
+
+
+def monitor_request(subcommand: int, serial_number: List[int], registration: List[RandomDevice]) -> bytes:
+    if subcommand != 0x0000 or len(registration) == 0:
+        return error_response(serial_number, Endcode.WrongCommand)
+    values: List[int] = []
+    for device, head_device_no, no_of_words, extension_specification, extension_type in registration:
+        values.extend(get_words(device, head_device_no, no_of_words, extension_specification, extension_type))
+    return read_response(serial_number, values)
+
+
+def block_read_request(subcommand: int, serial_number: List[int], data: bytes) -> bytes:
+    if subcommand != 0x0000 and subcommand != 0x0082:
+        return error_response(serial_number, Endcode.WrongCommand)
+    try:
+        word_blocks, bit_blocks = struct.unpack("BB", data[:2])
+        start = 2
+        values: List[int] = []
+        for _ in range(word_blocks + bit_blocks):
+            device, head_device_no, extension_specification, extension_type, start = parse_device_specification(subcommand, data, start)
+            no_of_words = struct.unpack("H", data[start : (start + 2)])[0]
+            start += 2
+            print(f"Block read: {device}, {head_device_no}, {no_of_words}")
+            values.extend(get_words(device, head_device_no, no_of_words, extension_specification, extension_type))
+    except (IndexError, KeyError, struct.error):
+        return error_response(serial_number, Endcode.InvalidDevice)
+    return read_response(serial_number, values)
+
+
+def parse_array_label(data: bytes, start: int) -> Tuple[str, int, DeviceType, int, int]:
+    # returns label name, index of the first element, unit, data length and the start of the next array
+    label_name_length = struct.unpack("H", data[start : (start + 2)])[0] * 2
+    label_name = "".join(chr(val) for val in struct.unpack("H" * int(label_name_length / 2), data[(start + 2) : (start + 2 + label_name_length)]))
+    label_index = int(label_name.split("[")[1].split("]")[0]) if "[" in label_name else 0
+    label_name = label_name.split("[")[0]
+    unit, _, data_length = struct.unpack("BBH", data[(start + 2 + label_name_length) : (start + 6 + label_name_length)])
+    return label_name, label_index, DeviceType.Bit if unit == 0 else DeviceType.Word, data_length, start + 6 + label_name_length
+
+
+def array_label_data_size(unit: DeviceType, data_length: int) -> int:
+    # bits are sent in units of words
+    return math.ceil(data_length / 16) * 2 if unit == DeviceType.Bit else data_length
+
+
+def array_label_read_request(subcommand: int, serial_number: List[int], data: bytes) -> bytes:
+    if subcommand != 0x0000:
+        return error_response(serial_number, Endcode.WrongCommand)
+    try:
+        number_of_arrays = struct.unpack("H", data[:2])[0]
+        start = 4
+        response_header_len = len(response_header(serial_number))
+        array_data = bytearray(struct.pack("B" * response_header_len, *response_header(serial_number)))
+        array_data += struct.pack("H", number_of_arrays)
+        for _ in range(number_of_arrays):
+            label_name, label_index, unit, data_length, start = parse_array_label(data, start)
+            values, datatype, _ = labels[label_name]
+            print(f"Array label read: {label_name}, {label_index}, {data_length}")
+            array_data += struct.pack("BBH", datatype.value[1], 0 if unit == DeviceType.Bit else 1, data_length)
+            if unit == DeviceType.Bit:
+                bits = bytearray(array_label_data_size(unit, data_length))
+                for i, value in enumerate(values[label_index : (label_index + data_length)]):
+                    bits[i // 8] |= int(value) << (i % 8)
+                array_data += bits
+            elif datatype == DatatypeId.String:
+                elements = values[label_index : (label_index + data_length // STRING_LABEL_SIZE)]
+                array_data += b"".join((value + b"\0" * STRING_LABEL_SIZE)[:STRING_LABEL_SIZE] for value in elements)
+            else:
+                elements = values[label_index : (label_index + data_length // datatype.value[2])]
+                array_data += struct.pack(datatype.value[0] * len(elements), *elements)
+    except (IndexError, KeyError, struct.error):
+        return error_response(serial_number, Endcode.InvalidGlobalLabel)
+    array_data[(response_header_len - 4) : (response_header_len - 2)] = struct.pack("H", len(array_data) - response_header_len + 2)
+    return bytes(array_data)
+
+
+def array_label_write_request(subcommand: int, serial_number: List[int], data: bytes) -> bytes:
+    if subcommand != 0x0000:
+        return error_response(serial_number, Endcode.WrongCommand)
+    try:
+        number_of_arrays = struct.unpack("H", data[:2])[0]
+        start = 4
+        for _ in range(number_of_arrays):
+            label_name, label_index, unit, data_length, start = parse_array_label(data, start)
+            values, datatype, _ = labels[label_name]
+            write_data = data[start : (start + array_label_data_size(unit, data_length))]
+            print(f"Array label write: {label_name}, {label_index}, {data_length}")
+            if unit == DeviceType.Bit:
+                elements = [bool((write_data[i // 8] >> (i % 8)) & 0x01) for i in range(data_length)]
+            elif datatype == DatatypeId.String:
+                elements = [write_data[i : (i + STRING_LABEL_SIZE)].rstrip(b"\0") for i in range(0, data_length, STRING_LABEL_SIZE)]
+            else:
+                elements = list(struct.unpack(datatype.value[0] * (data_length // datatype.value[2]), write_data))
+            values[label_index : (label_index + len(elements))] = elements
+            start += array_label_data_size(unit, data_length)
+    except (IndexError, KeyError, struct.error):
+        return error_response(serial_number, Endcode.InvalidGlobalLabel)
+    return success_response(serial_number)
+
+
 def read_response(serial_number: List[int], values: List[int]) -> bytes:
     response_header_len = len(response_header(serial_number))
     data = bytearray(struct.pack("B" * response_header_len, *response_header(serial_number)))
@@ -501,7 +663,7 @@ def fill_dicts() -> None:
     labels[E_LABEL[0]] = E_LABEL[1:]
     labels[S_LABEL[0]] = S_LABEL[1:]
     labels[S_ARRAY_LABEL[0]] = S_ARRAY_LABEL[1:]
-    labels[U_LABEL[0]] = U_LABEL[1:]
+    labels[U_LABEL[0]] = (U_LABEL[1].copy(), *U_LABEL[2:])  # copied, as array label writes change the list
     labels[WD_LABEL[0]] = WD_LABEL[1:]
     labels[UD_LABEL[0]] = UD_LABEL[1:]
 
@@ -520,94 +682,181 @@ def fill_dicts() -> None:
     variable_list[G_FLOAT_DEVICE[0]] = G_FLOAT_DEVICE[1:4]
 
 
-def main() -> None:
-    slmp = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-    slmp.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-    slmp.bind(("localhost", 5007))
-    slmp.listen(2)
-    print("PLC mockup running on localhost:5007")
-
+def receive_message(conn: socket.socket, stream: bytearray) -> bytes:
+    # requests can be split over several tcp segments and pipelined requests can share one, so the stream is split
+    # with the request data length in the header (9 bytes header, 13 bytes with the serial number of 4E frames)
     while True:
-        try:
-            (conn, addr) = slmp.accept()
-
-            fill_dicts()
-
-            while True:
-                message = conn.recv(1024)
-                if len(message) == 0:
-                    raise SLMPError([0xD0, 0x00], Endcode.WrongCommand)
-                subheader = struct.unpack("H", message[:2])[0]
-                if subheader == 0x50:
-                    serial_number = [0xD0, 0x00]
-                elif subheader == 0x54:
-                    serial_number = [
-                        0xD4,
-                        0x00,
-                        *struct.unpack("BB", message[2:4]),
-                        0x00,
-                        0x00,
-                    ]
-                elif subheader == 0x68:
-                    serial_number = [
-                        0xE8,
-                        0x00,
-                        *struct.unpack("BB", message[2:4]),
-                        0x00,
-                        0x00,
-                    ]
+        if len(stream) >= 2:
+            header_length = 13 if struct.unpack("H", stream[:2])[0] in (0x54, 0x68) else 9
+            if len(stream) >= header_length:
+                message_length = header_length + struct.unpack("H", stream[(header_length - 2) : header_length])[0]
+                if len(stream) >= message_length:
+                    message = bytes(stream[:message_length])
+                    del stream[:message_length]
+                    return message
+        data = conn.recv(4096)
+        if len(data) == 0:
+            return b""
+        stream += data
+
+
+def send_answer(conn: socket.socket, answer: bytes, latency: float, send_lock: threading.Lock) -> None:
+    # with a latency every answer is delayed on its own, like on a network with that round trip time, so that
+    # pipelined requests can be answered while earlier answers are still on their way
+    def send() -> None:
+        with send_lock:
+            try:
+                conn.sendall(answer)
+            except OSError:
+                pass
+
+    if latency > 0:
+        threading.Timer(latency, send).start()
+    else:
+        send()
+
+
+open_connections = 0
+connections_lock = threading.Lock()
+
+
+def serve(conn: socket.socket, latency: float, reject_monitor: bool) -> None:
+    global open_connections
+    send_lock = threading.Lock()
+    stream = bytearray()
+    registration: List[RandomDevice] = []
+    try:
+        while True:
+            message = receive_message(conn, stream)
+            if len(message) == 0:
+                raise SLMPError([0xD0, 0x00], Endcode.WrongCommand)
+            subheader = struct.unpack("H", message[:2])[0]
+            if subheader == 0x50:
+                serial_number = [0xD0, 0x00]
+            elif subheader == 0x54:
+                serial_number = [
+                    0xD4,
+                    0x00,
+                    *struct.unpack("BB", message[2:4]),
+                    0x00,
+                    0x00,
+                ]
+            elif subheader == 0x68:
+                serial_number = [
+                    0xE8,
+                    0x00,
+                    *struct.unpack("BB", message[2:4]),
+                    0x00,
+                    0x00,
+                ]
+            else:
+                raise SLMPError([0xD0, 0x00], Endcode.WrongFormat)
+            command: int = struct.unpack("H", message[(len(serial_number) + 9) : (len(serial_number) + 11)])[0]
+            subcommand: int = struct.unpack("H", message[(len(serial_number) + 11) : (len(serial_number) + 13)])[0]
+            if command == 0x0401 or command == 0x041C:
+                if message[(len(serial_number) + 13)] == 0x00:
+                    answer = extension_read_request(
+                        command,
+                        subcommand,
+                        serial_number,
+                        message[(len(serial_number) + 13) :],
+                    )
                 else:
-                    raise SLMPError([0xD0, 0x00], Endcode.WrongFormat)
-                command: int = struct.unpack("H", message[(len(serial_number) + 9) : (len(serial_number) + 11)])[0]
-                subcommand: int = struct.unpack("H", message[(len(serial_number) + 11) : (len(serial_number) + 13)])[0]
-                if command == 0x0401 or command == 0x041C:
-                    if message[(len(serial_number) + 13)] == 0x00:
-                        answer = extension_read_request(
-                            command,
-                            subcommand,
-                            serial_number,
-                            message[(len(serial_number) + 13) :],
-                        )
-                    else:
-                        answer = read_request(
-                            command,
-                            subcommand,
-                            serial_number,
-                            message[(len(serial_number) + 13) :],
-                        )
-                    conn.sendto(answer, addr)
-                elif command == 0x1401 or command == 0x141B:
-                    if message[(len(serial_number) + 13)] == 0x00:
-                        answer = extension_write_request(
-                            command,
-                            subcommand,
-                            serial_number,
-                            message[(len(serial_number) + 13) :],
-                        )
-                    else:
-                        answer = write_request(
-                            command,
-                            subcommand,
-                            serial_number,
-                            message[(len(serial_number) + 13) :],
-                        )
-                    conn.sendto(answer, addr)
-                elif command == 0x0619:
-                    # loopback message
-                    conn.sendto(loopback_response(serial_number, list(message)[17:]), addr)
+                    answer = read_request(
+                        command,
+                        subcommand,
+                        serial_number,
+                        message[(len(serial_number) + 13) :],
+                    )
+                send_answer(conn, answer, latency, send_lock)
+            elif command == 0x1401 or command == 0x141B:
+                if message[(len(serial_number) + 13)] == 0x00:
+                    answer = extension_write_request(
+                        command,
+                        subcommand,
+                        serial_number,
+                        message[(len(serial_number) + 13) :],
+                    )
                 else:
-                    raise SLMPError(serial_number, Endcode.WrongCommand)
-        except SLMPError as error:
-            answer = error_response(error.serial_number, error.endcode)
-            try:
-                conn.sendto(answer, addr)
-            except BrokenPipeError:
-                print(traceback.format_exc())
+                    answer = write_request(
+                        command,
+                        subcommand,
+                        serial_number,
+                        message[(len(serial_number) + 13) :],
+                    )
+                send_answer(conn, answer, latency, send_lock)
+            elif command == 0x0403:
+                answer = random_read_request(subcommand, serial_number, message[(len(serial_number) + 13) :])
+                send_answer(conn, answer, latency, send_lock)
+            elif command == 0x0406:
+                answer = block_read_request(subcommand, serial_number, message[(len(serial_number) + 13) :])
+                send_answer(conn, answer, latency, send_lock)
+            elif command == 0x0801:
+                if reject_monitor:
+                    # like a plc that doesn't support monitor registrations
+                    answer = error_response(serial_number, Endcode.WrongCommand)
+                else:
+                    answer = monitor_registration_request(subcommand, serial_number, message[(len(serial_number) + 13) :], registration)
+                send_answer(conn, answer, latency, send_lock)
+            elif command == 0x0802:
+                answer = monitor_request(subcommand, serial_number, registration)
+                send_answer(conn, answer, latency, send_lock)
+            elif command == 0x041A:
+                answer = array_label_read_request(subcommand, serial_number, message[(len(serial_number) + 13) :])
+                send_answer(conn, answer, latency, send_lock)
+            elif command == 0x141A:
+                answer = array_label_write_request(subcommand, serial_number, message[(len(serial_number) + 13) :])
+                send_answer(conn, answer, latency, send_lock)
+            elif command == 0x0619:
+                # loopback message
+                send_answer(conn, loopback_response(serial_number, list(message)[17:]), latency, send_lock)
+            else:
+                raise SLMPError(serial_number, Endcode.WrongCommand)
+    except SLMPError as error:
+        answer = error_response(error.serial_number, error.endcode)
+        try:
+            send_answer(conn, answer, latency, send_lock)
         except BrokenPipeError:
             print(traceback.format_exc())
-        except ConnectionError:
-            pass
+    except BrokenPipeError:
+        print(traceback.format_exc())
+    except ConnectionError:
+        pass
+    finally:
+        conn.close()
+        with connections_lock:
+            open_connections -= 1
+
+
+def listen(port: int, latency: float, reject_monitor: bool) -> None:
+    global open_connections
+    slmp = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    slmp.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    slmp.bind(("localhost", port))
+    slmp.listen(2)
+    print(f"PLC mockup running on localhost:{port}")
+
+    while True:
+        (conn, addr) = slmp.accept()
+        # answers are sent as soon as they are ready, not combined with later ones
+        conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        with connections_lock:
+            # the values are reset when the first connection is opened, all connections share the values like the
+            # ports of a real plc
+            if open_connections == 0:
+                fill_dicts()
+            open_connections += 1
+        threading.Thread(target=serve, args=(conn, latency, reject_monitor), daemon=True).start()
+
 
+def main() -> None:
+    # usage: plc.py [port[,port...]] [latency in ms] [port[,port...] that reject monitor registrations]
+    ports = [5007] if len(sys.argv) < 2 else [int(port) for port in sys.argv[1].split(",")]
+    latency = 0.0 if len(sys.argv) < 3 else float(sys.argv[2]) / 1000
+    reject_monitor_ports = [] if len(sys.argv) < 4 else [int(port) for port in sys.argv[3].split(",")]
+    for port in ports[1:]:
+        threading.Thread(target=listen, args=(port, latency, port in reject_monitor_ports), daemon=True).start()
+    listen(ports[0], latency, ports[0] in reject_monitor_ports)
 
 if __name__ == "__main__":
     main()
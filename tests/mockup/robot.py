@@ -2,6 +2,7 @@
 
 import socket
 import sys
+import time
 import traceback
 
 ROBOT_TYPE = "RV-4FRLM-D"
@@ -70,8 +71,27 @@ answers = {
 }
 
 
+def answer_command(message: str) -> str:
+    try:
+        answer = [
+            f"QoK{value}"
+            for key, value in answers.items()
+            if message.lower().startswith(key.lower()) or ";".join(message.split(";")[2:]).lower().startswith(key.lower())
+        ][0]
+        if message.startswith("1;1;OUT="):
+            answers.update({f"OUT{message.split('=')[1].split(';')[0]}": message.split(";")[3]})
+        return answer
+    except IndexError:
+        print(f"Invalid message: {message}")
+        return "QeR"
+
+
 def main() -> None:
-    port = 10001 if len(sys.argv) == 1 else int(sys.argv[1])
+    port = 10001 if len(sys.argv) <= 1 else int(sys.argv[1])
+    # simulated latency in ms of the robot controller, pipelined commands that arrive together share the latency
+    latency = 0.0 if len(sys.argv) <= 2 else float(sys.argv[2]) / 1000
+    # with "cr" commands and answers are terminated by a carriage return, like with the robot option Terminator "CR"
+    terminated = len(sys.argv) > 3 and sys.argv[3].lower() == "cr"
     r3 = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
     r3.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
     r3.bind(("localhost", port))
@@ -80,25 +100,25 @@ def main() -> None:
     while True:
         try:
             (conn, addr) = r3.accept()
+            conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
 
+            stream = ""
             while True:
                 message = conn.recv(1024).decode("latin-1")
-                if message != "":
-                    try:
-                        answer = [
-                            f"QoK{value}"
-                            for key, value in answers.items()
-                            if message.lower().startswith(key.lower()) or ";".join(message.split(";")[2:]).lower().startswith(key.lower())
-                        ][0]
-                        if message.startswith("1;1;OUT="):
-                            answers.update({f"OUT{message.split('=')[1].split(';')[0]}": message.split(";")[3]})
-
-                        conn.sendto(answer.encode("latin-1"), addr)
-                    except IndexError:
-                        print(f"Invalid message: {message}")
-                        conn.sendto(b"QeR", addr)
-                else:
+                if message == "":
                     raise ConnectionError()
+                if not terminated:
+                    # every receive is one command, the answer isn't terminated
+                    time.sleep(latency)
+                    conn.sendall(answer_command(message).encode("latin-1"))
+                    continue
+                # commands and answers are terminated by a carriage return, several commands can arrive at once
+                stream += message
+                *commands, stream = stream.split("\r")
+                if len(commands) == 0:
+                    continue
+                time.sleep(latency)
+                conn.sendall("".join(f"{answer_command(command)}\r" for command in commands).encode("latin-1"))
         except BrokenPipeError:
             print(traceback.format_exc())
         except ConnectionError:
@@ -8,10 +8,35 @@ import mockup.plc as plc_mock
 import pytest
 from asyncua import Client, Node, ua
 import os
+import asyncio
 
 
 url = "opc.tcp://127.0.0.1:5001/"
 namespace = "urn:open62541.server.application"
+# the plcs of test_clients.json and the ports the mockup answers them on, R04CPU-4E also uses 5009. the mockup
+# rejects the monitor registrations of R04CPU-NoMonitor
+plcs = ["R04CPU", "R04CPU-4E", "R04CPU-NoMonitor"]
+ports = [5007, 5008, 5009, 5010]
+reject_monitor_ports = [5010]
+mockup = [
+    "python3",
+    "tests/mockup/plc.py",
+    ",".join(str(port) for port in ports),
+    "0",
+    ",".join(str(port) for port in reject_monitor_ports),
+]
+
+
+def stop_mockup(client: subprocess.Popen) -> None:
+    if sys.platform == "win32":
+        client.send_signal(signal.CTRL_C_EVENT)
+    else:
+        client.send_signal(signal.SIGINT)
+    try:
+        client.wait(1)
+    except subprocess.TimeoutExpired:
+        client.terminate()
+        client.wait()
 
 
 @pytest.fixture(autouse=True)
@@ -22,8 +47,8 @@ def server():
     # create server.json
     shutil.copy("tests/test_server.json", "tests/server.json")
 
-    # start the client
-    client = subprocess.Popen(["python3", "tests/mockup/plc.py"])
+    # start the client, a test that restarts it appends the new one
+    clients = [subprocess.Popen(mockup)]
 
     # fill dicts
     plc_mock.fill_dicts()
@@ -33,11 +58,14 @@ def server():
     # start the server
     server = subprocess.Popen([os.environ["SERVER_EXECUTABLE"]], stderr=subprocess.PIPE)
 
+    started = 0
     for line in server.stderr:
         if b"Created plc node" in line:
+            started += 1
+        if started == len(plcs):
             break
 
-    yield
+    yield clients
 
     # shutdown server
     if sys.platform == "win32":
@@ -51,16 +79,10 @@ def server():
         server.terminate()
         server.wait()
 
-    # shutdown client
-    if sys.platform == "win32":
-        client.send_signal(signal.CTRL_C_EVENT)
-    else:
-        client.send_signal(signal.SIGINT)
-    try:
-        client.wait(1)
-    except subprocess.TimeoutExpired:
-        client.terminate()
-        client.wait()
+    # shutdown clients
+    for client in clients:
+        if client.poll() is None:
+            stop_mockup(client)
 
 
 @pytest.fixture()
@@ -70,6 +92,26 @@ async def plc_node() -> AsyncGenerator[Tuple[Node, int], None]:
         yield (await client.nodes.objects.get_child(f"{nsidx}:R04CPU")), nsidx
 
 
+@pytest.fixture()
+async def plc_4e_node() -> AsyncGenerator[Tuple[Node, int], None]:
+    async with Client(url=url, timeout=10) as client:
+        nsidx = await client.get_namespace_index(namespace)
+        yield (await client.nodes.objects.get_child(f"{nsidx}:R04CPU-4E")), nsidx
+
+
+async def get_polled_value(node: Node, timeout: float = 10):
+    # with AsyncIO a read of a node that wasn't polled yet is answered right away with BadWaitingForInitialData, the
+    # value is returned once it was read
+    deadline = time.monotonic() + timeout
+    while True:
+        try:
+            return await node.get_value()
+        except ua.UaStatusCodeError as error:
+            if error.code != ua.uatypes.status_codes.StatusCodes.BadWaitingForInitialData or time.monotonic() > deadline:
+                raise
+            await asyncio.sleep(0.1)
+
+
 @pytest.mark.asyncio
 async def test_global_label(plc_node: AsyncGenerator[Tuple[Node, int], None]):
     (plc, nsidx) = await plc_node.__anext__()
@@ -102,6 +144,10 @@ async def test_global_label(plc_node: AsyncGenerator[Tuple[Node, int], None]):
             elif datatype == plc_mock.DatatypeId.String:
                 await node.write_value("Hallo2", ua.VariantType.String)
                 assert await node.get_value() == "Hallo2"
+            elif datatype == plc_mock.DatatypeId.Word:
+                # array label
+                await node.write_value([2, 4, 6, 8], ua.VariantType.UInt16)
+                assert await node.get_value() == [2, 4, 6, 8]
 
 
 @pytest.mark.asyncio
@@ -146,3 +192,78 @@ async def test_special_areas(plc_node: AsyncGenerator[Tuple[Node, int], None]):
     assert await (await plc.get_child(f"{nsidx}:Production Information")).get_value() == plc_mock.PRODUCTION_INFORMATION
     assert await (await plc.get_child(f"{nsidx}:Operating Status")).get_value() == plc_mock.OPERATING_STATUS
     assert await (await plc.get_child(f"{nsidx}:Firmware Version")).get_value() == plc_mock.FIRMWARE_VERSION
+
+
+
+@pytest.mark.asyncio
+async def test_4e_frame(plc_4e_node: AsyncGenerator[Tuple[Node, int], None]):
+    (plc, nsidx) = await plc_4e_node.__anext__()
+    global_label: Node = await plc.get_child(f"{nsidx}:Global Label")
+    global_variables: Node = await plc.get_child(f"{nsidx}:Global Variables")
+
+    label: Node = await global_label.get_child(f"{nsidx}:wdLabel")
+    assert await get_polled_value(label) == plc_mock.labels["wdLabel"][0]
+    await label.write_value(75, ua.VariantType.Int32)
+    assert await label.get_value() == 75
+
+    # the device nodes are read with one monitor request, the labels and the U3E0 device with pipelined requests over
+    # both connections
+    for variable in ["M-Device", "D-Device", "D-Double-Device", "D-Double-Array-Device", "U3E0-Device"]:
+        (value, datatype, writeable) = plc_mock.variable_list[variable]
+        node: Node = await global_variables.get_child(f"{nsidx}:{variable}")
+        assert await get_polled_value(node) == value
+
+        if writeable:
+            if datatype == plc_mock.DatatypeId.Double:
+                await node.write_value(-300.0, ua.VariantType.Double)
+                assert await node.get_value() == -300.0
+            elif datatype == plc_mock.DatatypeId.Word:
+                await node.write_value(75, ua.VariantType.UInt16)
+                assert await node.get_value() == 75
+
+    # writes to the same device use the same connection, so the last write wins
+    node: Node = await global_variables.get_child(f"{nsidx}:D-Device")
+    for value in range(10):
+        await node.write_value(value, ua.VariantType.UInt16)
+    assert await node.get_value() == 9
+
+
+@pytest.mark.asyncio
+async def test_rejected_monitor_registration():
+    async with Client(url=url, timeout=10) as client:
+        nsidx = await client.get_namespace_index(namespace)
+        plc = await client.nodes.objects.get_child(f"{nsidx}:R04CPU-NoMonitor")
+        global_variables: Node = await plc.get_child(f"{nsidx}:Global Variables")
+
+        # the plc rejected the registration, so the device nodes are polled with read requests instead
+        for variable in ["M-Device", "D-DInt-Device"]:
+            node: Node = await global_variables.get_child(f"{nsidx}:{variable}")
+            assert await get_polled_value(node) == plc_mock.variable_list[variable][0]
+
+        node: Node = await global_variables.get_child(f"{nsidx}:D-DInt-Device")
+        await node.write_value(75, ua.VariantType.Int32)
+        assert await node.get_value() == 75
+
+
+@pytest.mark.asyncio
+async def test_reconnect(server):
+    clients = server
+    async with Client(url=url, timeout=10) as client:
+        nsidx = await client.get_namespace_index(namespace)
+        plc = await client.nodes.objects.get_child(f"{nsidx}:R04CPU-4E")
+        node: Node = await plc.get_child([f"{nsidx}:Global Variables", f"{nsidx}:D-Device"])
+        value = plc_mock.variable_list["D-Device"][0]
+        assert await get_polled_value(node) == value
+        await node.write_value(75, ua.VariantType.UInt16)
+        assert await node.get_value() == 75
+
+        # the restarted mockup drops the connections and starts with its initial values again
+        stop_mockup(clients[-1])
+        clients.append(subprocess.Popen(mockup))
+
+        # the node is kept while the plc is disconnected and returns the value of the plc once it is connected again
+        deadline = time.monotonic() + 15
+        while await node.get_value() != value:
+            assert time.monotonic() < deadline
+            await asyncio.sleep(0.2)
+        assert (await plc.get_child([f"{nsidx}:Global Variables", f"{nsidx}:D-Device"])).nodeid == node.nodeid
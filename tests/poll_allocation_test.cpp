@@ -0,0 +1,73 @@
+// counts the heap allocations of polling a plc and of reading the polled values, run it from the root of the
+// repository against the plc mockup, e.g. `python3 tests/mockup/plc.py`. fails if a poll or a read of the scalar nodes
+// still allocates once the arenas and the shadow values have their size
+#include <open62541/plugin/log_stdout.h>
+#include <open62541/server.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static UA_Logger file_logger = *UA_Log_Stdout;
+
+#include "allocation_counter.h"
+#include "plc.h"
+
+template <typename Function>
+static std::size_t count_allocations(const char* name, std::size_t iterations, Function function) {
+    const auto before = allocations.load();
+    for (std::size_t i = 0; i < iterations; i++) {
+        function();
+    }
+    const auto count = allocations.load() - before;
+    std::printf("%-32s %8.2f allocations per cycle\n", name,
+                static_cast<double>(count) / static_cast<double>(iterations));
+    return count;
+}
+
+int main(int argc, char** argv) {
+    UA_Server* server = UA_Server_new();
+    PLC plc("R04CPU", "127.0.0.1", argc > 1 ? std::atoi(argv[1]) : 5007, 0x00, 0xFF, 0x03FF, 0x00);
+    plc.slmp.connect();
+    if (!plc.slmp.connected) {
+        UA_Server_delete(server);
+        return EXIT_FAILURE;
+    }
+    create_plc_node(&plc, server, "tests/test_clients.json");
+
+    // strings are left out, a string whose length changes needs a new buffer in the shadow store
+    std::vector<const PLCNode*> scalar_nodes;
+    for (const auto node : plc.polled_nodes) {
+        if (node->count <= 1 && UA_TYPES[node->codec->ua_type].pointerFree) {
+            scalar_nodes.push_back(node);
+        }
+    }
+    const auto scalar_plan = plan_plc_reads(&plc, scalar_nodes);
+    constexpr std::size_t iterations = 100;
+
+    // reads the scalar nodes like the opc ua server does, which frees the value after encoding the response
+    const auto read_scalar_nodes = [&] {
+        for (const auto node : scalar_nodes) {
+            UA_DataValue data_value;
+            UA_DataValue_init(&data_value);
+            plc.shadow.read(node->node.identifier.numeric, &data_value, true);
+            UA_DataValue_clear(&data_value);
+        }
+    };
+
+    // the first cycles grow the arenas, create the shadow values and the buffers that are lent to the server
+    for (std::size_t i = 0; i < 3; i++) {
+        execute_plc_reads(&plc, scalar_plan);
+        poll_plc(&plc);
+        read_scalar_nodes();
+    }
+    const auto poll_allocations = count_allocations("poll of the scalar nodes", iterations,
+                                                    [&] { execute_plc_reads(&plc, scalar_plan); });
+    const auto read_allocations = count_allocations("read of the scalar nodes", iterations, read_scalar_nodes);
+    count_allocations("poll of all nodes", iterations, [&] { poll_plc(&plc); });
+
+    const bool connected = plc.slmp.connected;
+    delete_plc_node(&plc, server);
+    UA_Server_delete(server);
+    return connected && poll_allocations == 0 && read_allocations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -8,11 +8,14 @@ import mockup.robot as robot_mock
 import pytest
 from asyncua import Client, Node, ua
 import asyncio
+import json
 import os
 
 
 url = "opc.tcp://127.0.0.1:5001/"
 namespace = "urn:open62541.server.application"
+# the robots of test_clients.json, Robot-CR terminates its commands and answers with a carriage return
+robots = ["Robot1", "Robot-CR"]
 
 
 @pytest.fixture(autouse=True)
@@ -23,16 +26,25 @@ def server():
     # create server.json
     shutil.copy("tests/test_server.json", "tests/server.json")
 
-    # start the client
-    client = subprocess.Popen(["python3", "tests/mockup/robot.py"])
+    # remove stored robot structures, so that the robot is discovered
+    shutil.rmtree("tests/robots", ignore_errors=True)
+
+    # start the clients
+    clients = [
+        subprocess.Popen(["python3", "tests/mockup/robot.py"]),
+        subprocess.Popen(["python3", "tests/mockup/robot.py", "10004", "0", "cr"]),
+    ]
 
     time.sleep(1)
 
     # start the server
     server = subprocess.Popen([os.environ["SERVER_EXECUTABLE"]], stderr=subprocess.PIPE)
 
+    started = 0
     for line in server.stderr:
         if b"Created robot node" in line:
+            started += 1
+        if started == len(robots):
             break
 
     yield
@@ -49,16 +61,17 @@ def server():
         server.terminate()
         server.wait()
 
-    # shutdown client
-    if sys.platform == "win32":
-        client.send_signal(signal.CTRL_C_EVENT)
-    else:
-        client.send_signal(signal.SIGINT)
-    try:
-        client.wait(1)
-    except subprocess.TimeoutExpired:
-        client.terminate()
-        client.wait()
+    # shutdown clients
+    for client in clients:
+        if sys.platform == "win32":
+            client.send_signal(signal.CTRL_C_EVENT)
+        else:
+            client.send_signal(signal.SIGINT)
+        try:
+            client.wait(1)
+        except subprocess.TimeoutExpired:
+            client.terminate()
+            client.wait()
 
 
 @pytest.fixture
@@ -229,3 +242,28 @@ async def test_smart_plus(robot_node: AsyncGenerator[Tuple[Node, int], None]):
         await robot.get_child([f"{nsidx}:SmartPlus", f"{nsidx}:MaintenanceLog", f"{nsidx}:MaintenanceLog (grease)", f"{nsidx}:Axis 3"])
     ).get_value()
     assert robot_mock.ROBOT_MAINTENANCELOG_GREASE == maintenance_log_grease_j1
+
+
+@pytest.mark.asyncio
+async def test_terminator():
+    async with Client(url=url, timeout=10) as client:
+        nsidx = await client.get_namespace_index(namespace)
+        robot = await client.nodes.objects.get_child(f"{nsidx}:Robot-CR")
+
+        # the commands of a poll are sent ahead of their answers, which are split at the carriage returns
+        curr_pos = await (await robot.get_child([f"{nsidx}:Variables", f"{nsidx}:Current Position"])).get_value()
+        assert curr_pos == list([float(v) for v in robot_mock.ROBOT_P_CURR.replace(")(", ", ").replace(")", "").replace("(", "").split(", ")])
+        local_variable = await (await robot.get_child([f"{nsidx}:Variables", f"{nsidx}:LocalVariable"])).get_value()
+        assert local_variable == robot_mock.ROBOT_M1
+
+        robot_output: Node = await robot.get_child([f"{nsidx}:Outputs", f"{nsidx}:Outputs_64_79"])
+        assert (await robot_output.get_value()) == robot_mock.ROBOT_OUT[4]
+        await robot_output.write_value(10, ua.VariantType.Int32)
+        assert (await robot_output.get_value()) == 10
+
+
+def test_structure_cache():
+    with open(f"tests/robots/{robot_mock.ROBOT_SERIAL_NUMBER}-{robot_mock.ROBOT_CONTROLLER_VERSION}.json") as file:
+        answers = json.load(file)["Answers"]
+    assert answers["1;1;OPNUMRD"] == f"{len(robot_mock.ROBOT_ADDITIONAL_COMPONENTS)}"
+    assert answers["1;1;RAREAD="] == f";{robot_mock.ROBOT_SERIAL_NUMBER}"
@@ -0,0 +1,75 @@
+// counts the heap allocations of storing scalar values into the shadow store and of reading them back. once every
+// node has a value and was read once, neither storing a changed scalar nor reading it may allocate
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "allocation_counter.h"
+#include "shadow.h"
+
+constexpr std::size_t iterations = 1000;
+
+static bool expect(const char* name, std::size_t count, std::size_t expected) {
+    std::printf("%-40s %8.2f allocations per value\n", name,
+                static_cast<double>(count) / static_cast<double>(iterations));
+    if (count != expected * iterations) {
+        std::printf("%-40s expected %zu allocations per value\n", name, expected);
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    bool passed = true;
+    ShadowStore store;
+    ScratchArena arena;
+
+    // the values are borrowed from the arena like the values decoded by the device pollers
+    const auto int_value = arena.allocate<UA_Int32>(1);
+    const auto double_value = arena.allocate<UA_Double>(1);
+    const auto bool_value = arena.allocate<UA_Boolean>(1);
+    UA_Variant int_variant;
+    UA_Variant double_variant;
+    UA_Variant bool_variant;
+    borrow_scalar(&int_variant, int_value, &UA_TYPES[UA_TYPES_INT32]);
+    borrow_scalar(&double_variant, double_value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    borrow_scalar(&bool_variant, bool_value, &UA_TYPES[UA_TYPES_BOOLEAN]);
+
+    // the first store of a node creates its shadow value
+    store.store(1, &int_variant, UA_STATUSCODE_GOOD);
+    store.store(2, &double_variant, UA_STATUSCODE_GOOD);
+    store.store(3, &bool_variant, UA_STATUSCODE_GOOD);
+
+    auto before = allocations.load();
+    for (std::size_t i = 0; i < iterations; i++) {
+        *int_value = static_cast<UA_Int32>(i);
+        *double_value = static_cast<UA_Double>(i) / 2;
+        *bool_value = i % 2 == 0;
+        store.store(1, &int_variant, UA_STATUSCODE_GOOD);
+        store.store(2, &double_variant, UA_STATUSCODE_GOOD);
+        store.store(3, &bool_variant, i % 3 == 0 ? UA_STATUSCODE_BADDEVICEFAILURE : UA_STATUSCODE_GOOD);
+    }
+    passed &= expect("store of changed scalars", allocations.load() - before, 0);
+
+    // the first read of a node creates the buffers that are lent to the server
+    UA_DataValue data_value;
+    for (UA_UInt32 identifier = 1; identifier <= 3; identifier++) {
+        UA_DataValue_init(&data_value);
+        passed &= store.read(identifier, &data_value, true);
+        UA_DataValue_clear(&data_value);
+    }
+
+    before = allocations.load();
+    for (std::size_t i = 0; i < iterations; i++) {
+        UA_DataValue_init(&data_value);
+        passed &= store.read(static_cast<UA_UInt32>(1 + i % 3), &data_value, true);
+        UA_DataValue_clear(&data_value);
+    }
+    passed &= expect("read of scalars", allocations.load() - before, 0);
+
+    UA_DataValue_init(&data_value);
+    passed &= store.read(1, &data_value, false) && *static_cast<UA_Int32*>(data_value.value.data) ==
+                                                        static_cast<UA_Int32>(iterations - 1);
+    UA_DataValue_clear(&data_value);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+import os
+import subprocess
+import pytest
+
+
+# built next to the server, except on windows
+executable = os.path.join(os.path.dirname(os.environ.get("SERVER_EXECUTABLE", "")), "shadow_allocation_test")
+
+
+@pytest.mark.skipif(not os.path.isfile(executable), reason="shadow_allocation_test is not built on windows")
+def test_shadow_allocations():
+    result = subprocess.run([executable], capture_output=True, text=True)
+    print(result.stdout)
+    assert result.returncode == 0
@@ -0,0 +1,33 @@
+# runs a test executable while the plc mockup is running, for the ctests that talk to a plc
+# usage: with_plc_mockup.py port executable [arguments...], run it from the root of the repository
+import socket
+import subprocess
+import sys
+import time
+
+
+def wait_for_mockup(port: int) -> None:
+    deadline = time.monotonic() + 10
+    while True:
+        try:
+            socket.create_connection(("127.0.0.1", port), timeout=1).close()
+            return
+        except OSError:
+            if time.monotonic() > deadline:
+                raise
+            time.sleep(0.1)
+
+
+def main() -> int:
+    port = int(sys.argv[1])
+    mockup = subprocess.Popen([sys.executable, "tests/mockup/plc.py", str(port)], stdout=subprocess.DEVNULL)
+    try:
+        wait_for_mockup(port)
+        return subprocess.run(sys.argv[2:]).returncode
+    finally:
+        mockup.terminate()
+        mockup.wait()
+
+
+if __name__ == "__main__":
+    sys.exit(main())